@@ -0,0 +1,57 @@
+#!/bin/bash
+# vim: tabstop=4 shiftwidth=4 expandtab
+#
+# Compare two results of bench/run.sh, for example of two commits. For every
+# time or speed measured in both, prints the old and the new value and the
+# change in percent; a positive change means the new one is faster. The
+# lines are matched by their suite, variant and input.
+#
+# Usage: bench/compare.sh OLD NEW
+#
+# Copyright 2009 Martina Kollarova
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 OLD NEW" >&2
+    exit 1
+fi
+
+awk -F'\t' '
+    # times are better lower, speeds (gbps, mops...) higher
+    function lower_is_better(name) { return name ~ /(ms|ns|seconds)$/ }
+    function measured(name) {
+        return name ~ /(ms|ns|seconds|gbps|mops|per_s)$/
+    }
+    {
+        key = ""
+        for(i = 1; i <= NF; i++) {
+            if(index($i, "=") == 0) {
+                key = key $i "\t"
+                continue
+            }
+            split($i, pair, "=")
+            if(!measured(pair[1]))
+                continue
+            if(NR == FNR) {
+                old[key pair[1]] = pair[2]
+            }
+            else if((key pair[1]) in old && old[key pair[1]] > 0) {
+                o = old[key pair[1]]
+                if(lower_is_better(pair[1])) change = (o - pair[2]) / o * 100
+                else change = (pair[2] - o) / o * 100
+                printf "%s%s\t%s\t%s\t%+.1f%%\n", key, pair[1], o, pair[2],
+                       change
+            }
+        }
+    }' "$1" "$2"
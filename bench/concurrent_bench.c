@@ -0,0 +1,187 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Compare the throughput of the concurrent hash table with a single mutex
+ * around htable_t, when many threads count words with a Zipfian distribution
+ * (the most common word is twice as common as the second one, etc.). For
+ * comparison, the same words are also only looked up with htable_find() in a
+ * htable_t that already has all of them, which needs no lock. Prints one line
+ * per table and number of threads, in millions of words per second.
+ *
+ * Usage: bench/concurrent_bench [MAX_THREADS]
+ *   The default is twice the number of online CPUs.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <inttypes.h>
+
+#include "htable.h"
+#include "htable_concurrent.h"
+
+#define KEYS 100000
+#define STREAM (4 * 1000 * 1000)
+
+static char keys[KEYS][16];
+static unsigned int stream[STREAM];
+
+static htable_concurrent_t *concurrent;
+static htable_t *locked;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct job {
+    pthread_t thread;
+    size_t from, to;
+    int mode;
+} job_t;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void die(const char *msg) {
+    perror(msg);
+    exit(EXIT_FAILURE);
+}
+
+/* Fill the stream with key numbers, the key with rank k has the probability
+ * proportional to 1/k. */
+static void generate(void) {
+    double *cdf = malloc(KEYS * sizeof(double));
+    if(cdf == NULL)
+        die("malloc");
+    double sum = 0;
+    for(unsigned int k = 0; k < KEYS; k++) {
+        sum += 1.0 / (k + 1);
+        cdf[k] = sum;
+        sprintf(keys[k], "w%u", k);
+    }
+    unsigned long long x = 88172645463325252ULL;
+    for(size_t i = 0; i < STREAM; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        double r = (double)(x >> 11) / (1ULL << 53) * sum;
+        unsigned int lo = 0, hi = KEYS - 1;
+        while(lo < hi) {
+            unsigned int mid = (lo + hi) / 2;
+            if(cdf[mid] < r)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        stream[i] = lo;
+    }
+    free(cdf);
+}
+
+static void * count(void *arg) {
+    job_t *job = arg;
+    for(size_t i = job->from; i < job->to; i++) {
+        const char *key = keys[stream[i]];
+        if(job->mode == 0) {
+            if(htable_concurrent_lookup(concurrent, key) == NULL)
+                die("htable_concurrent_lookup");
+        }
+        else if(job->mode == 2) {
+            if(htable_find(locked, key, strlen(key)) == NULL)
+                die("htable_find");
+        }
+        else {
+            pthread_mutex_lock(&lock);
+            htable_listitem_t *item = htable_lookup(locked, key);
+            pthread_mutex_unlock(&lock);
+            if(item == NULL)
+                die("htable_lookup");
+        }
+    }
+    return NULL;
+}
+
+static void sum_data(htable_concurrent_item_t *item, void *arg) {
+    *(uint64_t *)arg += item->data;
+}
+
+int main(int argc, char *argv[]) {
+    long max_threads = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+    if(argc > 1)
+        max_threads = strtol(argv[1], NULL, 10);
+    if(max_threads < 1)
+        max_threads = 1;
+    job_t *jobs = malloc(max_threads * sizeof(job_t));
+    if(jobs == NULL)
+        die("malloc");
+    generate();
+
+    for(long threads = 1; threads <= max_threads; threads *= 2) {
+        for(int mode = 0; mode < 3; mode++) {
+            concurrent = htable_concurrent_init(KEYS);
+            locked = htable_init(2000);
+            if(concurrent == NULL || locked == NULL)
+                die("init");
+            uint64_t expected = STREAM;
+            if(mode == 2) {
+                // every key once, htable_find() doesn't change the counts
+                for(int k = 0; k < KEYS; k++) {
+                    if(htable_lookup(locked, keys[k]) == NULL)
+                        die("htable_lookup");
+                }
+                expected = KEYS;
+            }
+
+            double start = now();
+            for(long t = 0; t < threads; t++) {
+                jobs[t].from = STREAM / threads * t;
+                jobs[t].to = (t == threads - 1) ? STREAM
+                                                : STREAM / threads * (t + 1);
+                jobs[t].mode = mode;
+                if(pthread_create(&jobs[t].thread, NULL, count, &jobs[t]))
+                    die("pthread_create");
+            }
+            for(long t = 0; t < threads; t++)
+                pthread_join(jobs[t].thread, NULL);
+            double elapsed = now() - start;
+
+            uint64_t total = 0;
+            if(mode == 0) {
+                htable_concurrent_foreach(concurrent, sum_data, &total);
+            }
+            else {
+                for(htable_iterator_t it = htable_begin(locked);
+                        it.ptr != NULL; it = htable_it_next(it))
+                    total += it.ptr->data;
+            }
+            if(total != expected) {
+                fprintf(stderr, "counted %" PRIu64 " words instead of %"
+                        PRIu64 "\n", total, expected);
+                return EXIT_FAILURE;
+            }
+            static const char *names[] = {"concurrent", "mutex", "find"};
+            printf("%s\tthreads=%ld\tmops=%.2f\n", names[mode], threads,
+                   STREAM / elapsed / 1e6);
+            htable_concurrent_free(&concurrent);
+            htable_free(&locked);
+        }
+    }
+    free(jobs);
+    return 0;
+}
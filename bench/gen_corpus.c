@@ -0,0 +1,136 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Generate a text corpus for the benchmarks, always the same for the same
+ * arguments. The words are drawn from a vocabulary of DISTINCT words, either
+ * all of them equally likely (uniform) or with the k-th most common word
+ * 1/k times as likely as the most common one (zipf, like in natural
+ * language). The words of the `long` corpus are about 60 to 95 bytes long,
+ * like paths, the others about 3 to 15 bytes. There are 12 words per line.
+ *
+ * Usage: bench/gen_corpus uniform|zipf|long WORDS [DISTINCT [SEED]]
+ *   DISTINCT defaults to 100000, SEED to 1.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define WORDS_PER_LINE 12
+
+static uint64_t random_state;
+
+/* xorshift64* */
+static uint64_t next_random(void) {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 0x2545f4914f6cdd1dULL;
+}
+
+static void die(const char *msg) {
+    perror(msg);
+    exit(EXIT_FAILURE);
+}
+
+/* Write the i-th word of the vocabulary into 'out', return its length. Its
+ * letters come from a hash of i, so that the words look random. */
+static int make_word(char *out, unsigned long i, int long_words) {
+    uint64_t h = (i + 1) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 31;
+    int len = long_words ? 56 + h % 32 : 2 + h % 8;
+    for(int k = 0; k < len; k++) {
+        h = h * 6364136223846793005ULL + 1442695040888963407ULL;
+        out[k] = 'a' + (h >> 33) % 26;
+    }
+    if(long_words) {
+        // path-like, with a unique number so that no two words are the same
+        len += sprintf(out + len, "/%lu", i);
+        for(int k = 10; k < len - 12; k += 17)
+            out[k] = '/';
+    }
+    else {
+        // the number makes the word unique
+        len += sprintf(out + len, "%lu", i);
+    }
+    return len;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 3) {
+        fputs("Usage: bench/gen_corpus uniform|zipf|long WORDS "
+              "[DISTINCT [SEED]]\n", stderr);
+        return EXIT_FAILURE;
+    }
+    int zipf = strcmp(argv[1], "zipf") == 0;
+    int long_words = strcmp(argv[1], "long") == 0;
+    if(!zipf && !long_words && strcmp(argv[1], "uniform") != 0) {
+        fprintf(stderr, "Unknown corpus %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    unsigned long words = strtoul(argv[2], NULL, 10);
+    unsigned long distinct = argc > 3 ? strtoul(argv[3], NULL, 10) : 100000;
+    random_state = argc > 4 ? strtoull(argv[4], NULL, 10) : 1;
+    if(distinct == 0) distinct = 1;
+    if(random_state == 0) random_state = 1;
+
+    // the whole vocabulary, one word after another
+    size_t max_len = long_words ? 128 : 32;
+    char *vocabulary = malloc(distinct * max_len);
+    unsigned char *lengths = malloc(distinct);
+    if(vocabulary == NULL || lengths == NULL)
+        die("malloc");
+    for(unsigned long i = 0; i < distinct; i++)
+        lengths[i] = make_word(vocabulary + i * max_len, i, long_words);
+
+    // cumulative probabilities of the Zipf distribution
+    double *cdf = NULL;
+    if(zipf) {
+        cdf = malloc(distinct * sizeof(double));
+        if(cdf == NULL)
+            die("malloc");
+        double sum = 0;
+        for(unsigned long i = 0; i < distinct; i++)
+            cdf[i] = (sum += 1.0 / (i + 1));
+        for(unsigned long i = 0; i < distinct; i++)
+            cdf[i] /= sum;
+    }
+
+    for(unsigned long n = 0; n < words; n++) {
+        unsigned long i;
+        if(zipf) {
+            double x = (next_random() >> 11) * (1.0 / 9007199254740992.0);
+            unsigned long low = 0, high = distinct - 1;
+            while(low < high) {
+                unsigned long middle = low + (high - low) / 2;
+                if(cdf[middle] < x) low = middle + 1;
+                else high = middle;
+            }
+            i = low;
+        }
+        else {
+            i = next_random() % distinct;
+        }
+        fwrite(vocabulary + i * max_len, 1, lengths[i], stdout);
+        putchar((n + 1) % WORDS_PER_LINE == 0 ? '\n' : ' ');
+    }
+    if(words % WORDS_PER_LINE != 0)
+        putchar('\n');
+    free(vocabulary);
+    free(lengths);
+    free(cdf);
+    return ferror(stdout) ? EXIT_FAILURE : 0;
+}
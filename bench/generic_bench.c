@@ -0,0 +1,164 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Compare the map generated by HTABLE_DEFINE() (htable_generic.h) with the
+ * backends of htable_t, counting the words of each FILE with both, and check
+ * that they give the same counts. Prints the average time per word of the
+ * first pass over the words (mostly inserts) and of the second (hits only),
+ * in the same format as bench/htable_bench. The generated map keeps pointers
+ * into the file instead of copies of the keys.
+ *
+ * Usage: bench/generic_bench FILE...
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "htable.h"
+#include "htable_generic.h"
+#include "io.h"
+
+HTABLE_DEFINE(word_counts, htable_str_t, uint64_t, htable_str_hash,
+              htable_str_eq)
+
+typedef struct words {
+    htable_str_t *list;
+    size_t count;
+} words_t;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void die(const char *msg) {
+    perror(msg);
+    exit(EXIT_FAILURE);
+}
+
+/* Split the whole file into words, which point into 'data'. */
+static words_t read_words(const char *filename, char **data) {
+    FILE *file = fopen(filename, "r");
+    if(file == NULL)
+        die(filename);
+    fseek(file, 0, SEEK_END);
+    size_t size = ftell(file);
+    rewind(file);
+    *data = malloc(size + 1);
+    if(*data == NULL || fread(*data, 1, size, file) != size)
+        die(filename);
+    fclose(file);
+
+    words_t words = {NULL, 0};
+    size_t capacity = 0;
+    tokenizer_t tokenizer;
+    tokenizer_init_memory(&tokenizer, *data, size);
+    const char *word;
+    size_t len;
+    while((word = tokenizer_next(&tokenizer, &len)) != NULL) {
+        if(words.count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            words.list = realloc(words.list, capacity * sizeof(htable_str_t));
+            if(words.list == NULL)
+                die("realloc");
+        }
+        words.list[words.count].str = word;
+        words.list[words.count++].len = len;
+    }
+    return words;
+}
+
+static void run(const char *corpus, const words_t *words) {
+    const htable_backend_t backends[] = {HTABLE_CHAINED, HTABLE_SWISS};
+    const char *names[] = {"chained", "swiss"};
+    double times[2];
+
+    htable_t *tables[2];
+    for(int b = 0; b < 2; b++) {
+        tables[b] = htable_init_backend(2000, backends[b]);
+        if(tables[b] == NULL)
+            die("htable_init_backend");
+        for(int pass = 0; pass < 2; pass++) {
+            double start = now();
+            for(size_t i = 0; i < words->count; i++) {
+                if(htable_lookup_len(tables[b], words->list[i].str,
+                                     words->list[i].len) == NULL)
+                    die("htable_lookup_len");
+            }
+            times[pass] = (now() - start) * 1e9 / words->count;
+        }
+        printf("%s\t%s\twords=%zu\tunique=%lu\t"
+               "first_ns=%.1f\tsecond_ns=%.1f\n",
+               names[b], corpus, words->count, tables[b]->count,
+               times[0], times[1]);
+    }
+
+    word_counts_t map;
+    if(!word_counts_init(&map, 2000))
+        die("word_counts_init");
+    for(int pass = 0; pass < 2; pass++) {
+        double start = now();
+        for(size_t i = 0; i < words->count; i++) {
+            bool inserted;
+            word_counts_entry_t *entry =
+                word_counts_insert(&map, words->list[i], &inserted);
+            if(entry == NULL)
+                die("word_counts_insert");
+            entry->value++;
+        }
+        times[pass] = (now() - start) * 1e9 / words->count;
+    }
+    printf("generic\t%s\twords=%zu\tunique=%zu\t"
+           "first_ns=%.1f\tsecond_ns=%.1f\n",
+           corpus, words->count, map.count, times[0], times[1]);
+
+    // both passes counted every word, so the counts are the same
+    if(map.count != tables[0]->count) {
+        fprintf(stderr, "%s: different number of keys\n", corpus);
+        exit(EXIT_FAILURE);
+    }
+    for(htable_iterator_t it = htable_begin(tables[0]); it.ptr != NULL;
+            it = htable_it_next(it)) {
+        htable_str_t key = {it.ptr->key, it.ptr->len};
+        word_counts_entry_t *entry = word_counts_find(&map, key);
+        if(entry == NULL || entry->value != it.ptr->data) {
+            fprintf(stderr, "%s: different count of '%s'\n", corpus,
+                    it.ptr->key);
+            exit(EXIT_FAILURE);
+        }
+    }
+    word_counts_free(&map);
+    htable_free(&tables[0]);
+    htable_free(&tables[1]);
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        fputs("Usage: bench/generic_bench FILE...\n", stderr);
+        return EXIT_FAILURE;
+    }
+    for(int i = 1; i < argc; i++) {
+        char *data;
+        words_t words = read_words(argv[i], &data);
+        run(argv[i], &words);
+        free(words.list);
+        free(data);
+    }
+    return 0;
+}
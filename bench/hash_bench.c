@@ -0,0 +1,198 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Compare the hash functions of the hash table. For every corpus of unique
+ * keys, hash function and way of reducing the hash to an index, prints the
+ * average time to hash a key and how the keys are distributed over the lists
+ * of a table with one list per key (HTABLE_MODULO) or the nearest power of
+ * two (HTABLE_MASK): the percentage of lists with 0, 1, 2, 3, 4 and more keys
+ * and the longest list. A perfectly random hash at load 1.0 leaves about 37%
+ * of the lists empty, 37% with one key and 18% with two.
+ *
+ * Usage: bench/hash_bench [FILE...]
+ *   Uses the unique words of each FILE, as well as generated hex IDs, file
+ *   paths and decimal numbers.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "htable.h"
+#include "io.h"
+
+#define MAX_WORD_SIZE 100 + 1
+#define GENERATED_KEYS 500000
+// every hash function hashes at least this many keys when measuring time
+#define MIN_HASHED 5000000
+
+// keeps the compiler from optimizing the hashing away
+static volatile uint64_t sink;
+
+typedef struct keys {
+    const char **list;
+    size_t *len;
+    size_t count;
+} keys_t;
+
+static const struct {
+    const char *name;
+    htable_hash_t hash;
+} functions[] = {
+    {"mult31", htable_hash_mult31},
+    {"fnv1a",  htable_hash_fnv1a},
+    {"wyhash", htable_hash_wyhash},
+};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void die(const char *msg) {
+    perror(msg);
+    exit(EXIT_FAILURE);
+}
+
+/* The keys point to the items of the table, which removes the duplicates. */
+static keys_t keys_from_table(htable_t *htable) {
+    keys_t keys = {NULL, NULL, 0};
+    keys.list = malloc(htable->count * sizeof(char *));
+    keys.len = malloc(htable->count * sizeof(size_t));
+    if(keys.list == NULL || keys.len == NULL)
+        die("malloc");
+    for(htable_iterator_t it = htable_begin(htable); it.ptr != NULL;
+            it = htable_it_next(it)) {
+        keys.list[keys.count] = it.ptr->key;
+        keys.len[keys.count++] = strlen(it.ptr->key);
+    }
+    return keys;
+}
+
+static void keys_free(keys_t *keys) {
+    free(keys->list);
+    free(keys->len);
+}
+
+static void run(const char *corpus, const keys_t *keys) {
+    unsigned int *lists = NULL;
+    for(size_t f = 0; f < sizeof(functions) / sizeof(functions[0]); f++) {
+        // speed
+        size_t rounds = MIN_HASHED / keys->count + 1;
+        uint64_t sum = 0;
+        double start = now();
+        for(size_t r = 0; r < rounds; r++) {
+            for(size_t i = 0; i < keys->count; i++)
+                sum += functions[f].hash(keys->list[i], keys->len[i]);
+        }
+        double ns = (now() - start) * 1e9 / (rounds * keys->count);
+        sink = sum;
+
+        // distribution
+        for(int mask = 0; mask < 2; mask++) {
+            size_t size = keys->count;
+            if(mask) {
+                size = 1;
+                while(size < keys->count)
+                    size *= 2;
+            }
+            lists = realloc(lists, size * sizeof(unsigned int));
+            if(lists == NULL)
+                die("realloc");
+            memset(lists, 0, size * sizeof(unsigned int));
+            for(size_t i = 0; i < keys->count; i++) {
+                uint64_t h = functions[f].hash(keys->list[i], keys->len[i]);
+                lists[mask ? (h & (size - 1)) : (h % size)]++;
+            }
+            size_t histogram[6] = {0};
+            unsigned int max = 0;
+            for(size_t i = 0; i < size; i++) {
+                histogram[lists[i] < 5 ? lists[i] : 5]++;
+                if(lists[i] > max)
+                    max = lists[i];
+            }
+            printf("%s\t%s\t%s\tkeys=%zu\tns_per_key=%.2f\tlists=%zu\t"
+                   "0=%.1f%%\t1=%.1f%%\t2=%.1f%%\t3=%.1f%%\t4=%.1f%%\t"
+                   "5+=%.1f%%\tmax=%u\n",
+                   functions[f].name, mask ? "mask" : "modulo", corpus,
+                   keys->count, ns, size,
+                   100.0 * histogram[0] / size, 100.0 * histogram[1] / size,
+                   100.0 * histogram[2] / size, 100.0 * histogram[3] / size,
+                   100.0 * histogram[4] / size, 100.0 * histogram[5] / size,
+                   max);
+        }
+    }
+    free(lists);
+}
+
+/* Generate the keys with the given printf format and run the benchmark. */
+static void run_generated(const char *corpus, int type) {
+    htable_t *htable = htable_init(GENERATED_KEYS);
+    if(htable == NULL)
+        die("htable_init");
+    char s[MAX_WORD_SIZE];
+    unsigned long long x = 88172645463325252ULL;
+    for(unsigned int i = 0; i < GENERATED_KEYS; i++) {
+        switch(type) {
+        case 0:  // random 64-bit IDs (xorshift)
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            sprintf(s, "%016llx", x);
+            break;
+        case 1:
+            sprintf(s, "/var/log/service%u/2026-10-%02u/part-%05u.log",
+                    i % 37, i % 31 + 1, i / 1147);
+            break;
+        default:
+            sprintf(s, "%u", i);
+        }
+        if(htable_lookup(htable, s) == NULL)
+            die("htable_lookup");
+    }
+    keys_t keys = keys_from_table(htable);
+    run(corpus, &keys);
+    keys_free(&keys);
+    htable_free(&htable);
+}
+
+int main(int argc, char *argv[]) {
+    char s[MAX_WORD_SIZE];
+
+    for(int i = 1; i < argc; i++) {
+        FILE *file = fopen(argv[i], "r");
+        if(file == NULL)
+            die(argv[i]);
+        htable_t *htable = htable_init(2000);
+        if(htable == NULL)
+            die("htable_init");
+        while(read_word(s, MAX_WORD_SIZE, file)) {
+            if(htable_lookup(htable, s) == NULL)
+                die("htable_lookup");
+        }
+        fclose(file);
+        keys_t keys = keys_from_table(htable);
+        run(argv[i], &keys);
+        keys_free(&keys);
+        htable_free(&htable);
+    }
+    run_generated("hex_ids", 0);
+    run_generated("paths", 1);
+    run_generated("numbers", 2);
+    return 0;
+}
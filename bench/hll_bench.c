@@ -0,0 +1,137 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Accuracy and speed of the HyperLogLog sketch (htable_hll.h). For every
+ * precision, generated sets of 10 to 10 million different keys are added to
+ * the sketch, and the mean and the worst relative error of the estimate over
+ * a few runs are printed. Then the words of FILE, replicated in memory, are
+ * added to a sketch and, for comparison, counted exactly in a hash table.
+ *
+ * Usage: bench/hll_bench [FILE [COPIES]]
+ *   COPIES defaults to 50.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "htable.h"
+#include "htable_hll.h"
+#include "io.h"
+
+#define MAX_KEYS 10000000
+#define RUNS 5
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void die(const char *msg) {
+    perror(msg);
+    exit(EXIT_FAILURE);
+}
+
+/* The estimate is checked at every power of ten while the keys are added,
+ * each run with different keys. */
+static void accuracy(unsigned int precision) {
+    double sum[8] = {0}, worst[8] = {0};
+    for(int run = 0; run < RUNS; run++) {
+        htable_hll_t *hll = htable_hll_init(precision);
+        if(hll == NULL)
+            die("htable_hll_init");
+        char key[64];
+        unsigned long next = 10;
+        for(unsigned long n = 1; n <= MAX_KEYS; n++) {
+            int len = sprintf(key, "%d-%lu", run, n);
+            htable_hll_add(hll, key, len);
+            if(n == next) {
+                int i = (int)log10(n);
+                double error = htable_hll_estimate(hll) / n - 1.0;
+                sum[i] += fabs(error);
+                if(fabs(error) > worst[i])
+                    worst[i] = fabs(error);
+                next *= 10;
+            }
+        }
+        htable_hll_free(&hll);
+    }
+    for(int i = 1; i <= 7; i++) {
+        printf("precision=%u\tbytes=%u\tkeys=%.0f\tmean_error=%.4f\t"
+               "worst_error=%.4f\n", precision, 1u << precision,
+               pow(10, i), sum[i] / RUNS, worst[i]);
+    }
+}
+
+static void throughput(const char *filename, size_t copies) {
+    FILE *file = fopen(filename, "r");
+    if(file == NULL)
+        die(filename);
+    fseek(file, 0, SEEK_END);
+    size_t size = ftell(file);
+    rewind(file);
+    char *data = malloc(size * copies + 1);
+    if(data == NULL)
+        die("malloc");
+    if(fread(data, 1, size, file) != size)
+        die("fread");
+    fclose(file);
+    for(size_t i = 1; i < copies; i++)
+        memcpy(data + i * size, data, size);
+
+    tokenizer_t tokenizer;
+    const char *word;
+    size_t len, words = 0;
+    htable_hll_t *hll = htable_hll_init(HTABLE_HLL_PRECISION);
+    if(hll == NULL)
+        die("htable_hll_init");
+    double start = now();
+    tokenizer_init_memory(&tokenizer, data, size * copies);
+    while((word = tokenizer_next(&tokenizer, &len)) != NULL) {
+        htable_hll_add(hll, word, len);
+        words++;
+    }
+    double elapsed = now() - start;
+    printf("hll\twords=%zu\testimate=%.0f\tmwords_per_s=%.1f\n", words,
+           htable_hll_estimate(hll), words / elapsed / 1e6);
+    htable_hll_free(&hll);
+
+    htable_t *htable = htable_init(2000);
+    if(htable == NULL)
+        die("htable_init");
+    start = now();
+    tokenizer_init_memory(&tokenizer, data, size * copies);
+    while((word = tokenizer_next(&tokenizer, &len)) != NULL) {
+        if(htable_lookup_len(htable, word, len) == NULL)
+            die("htable_lookup_len");
+    }
+    elapsed = now() - start;
+    printf("htable\twords=%zu\texact=%lu\tmwords_per_s=%.1f\n", words,
+           htable->count, words / elapsed / 1e6);
+    htable_free(&htable);
+    free(data);
+}
+
+int main(int argc, char *argv[]) {
+    for(unsigned int p = 10; p <= 16; p += 2)
+        accuracy(p);
+    if(argc > 1)
+        throughput(argv[1], argc > 2 ? strtoul(argv[2], NULL, 10) : 50);
+    return 0;
+}
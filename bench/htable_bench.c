@@ -0,0 +1,173 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Compare the speed of the hash table backends (HTABLE_CHAINED and
+ * HTABLE_SWISS). Prints one line per backend and input, with the average
+ * time of the first lookup of every word (mostly inserts of new keys) and
+ * of the second lookup of every word (hits only), looked up one by one and
+ * with htable_lookup_batch() in batches of BATCH words, and the time per key
+ * of iterating the whole table.
+ *
+ * Usage: bench/htable_bench [FILE...]
+ *   Uses the words of each FILE as input, as well as a generated set of one
+ *   million unique keys.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "htable.h"
+#include "io.h"
+
+#define MAX_WORD_SIZE 100 + 1
+#define UNIQUE_KEYS 1000000
+#define BATCH 32
+
+typedef struct words {
+    char **list;
+    size_t count;
+} words_t;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void words_add(words_t *words, const char *word) {
+    if((words->count & (words->count - 1)) == 0) {
+        size_t size = words->count ? words->count * 2 : 1;
+        words->list = realloc(words->list, size * sizeof(char *));
+        if(words->list == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    words->list[words->count] = malloc(strlen(word) + 1);
+    if(words->list[words->count] == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    strcpy(words->list[words->count++], word);
+}
+
+static void words_free(words_t *words) {
+    for(size_t i = 0; i < words->count; i++)
+        free(words->list[i]);
+    free(words->list);
+    words->list = NULL;
+    words->count = 0;
+}
+
+/* Average ns of the first and the second lookup of every word in batches. */
+static void run_batch(htable_backend_t backend, const words_t *words,
+                      double times[2]) {
+    htable_str_t *keys = malloc(words->count * sizeof(htable_str_t));
+    htable_t *htable = htable_init_backend(2000, backend);
+    if(keys == NULL || htable == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < words->count; i++) {
+        keys[i].str = words->list[i];
+        keys[i].len = strlen(words->list[i]);
+    }
+    htable_listitem_t *results[BATCH];
+    for(int pass = 0; pass < 2; pass++) {
+        double start = now();
+        for(size_t i = 0; i < words->count; i += BATCH) {
+            size_t n = words->count - i < BATCH ? words->count - i : BATCH;
+            if(!htable_lookup_batch(htable, keys + i, n, results)) {
+                perror("htable_lookup_batch");
+                exit(EXIT_FAILURE);
+            }
+        }
+        times[pass] = (now() - start) * 1e9 / words->count;
+    }
+    htable_free(&htable);
+    free(keys);
+}
+
+static void run(const char *corpus, const words_t *words) {
+    const htable_backend_t backends[] = {HTABLE_CHAINED, HTABLE_SWISS};
+    const char *names[] = {"chained", "swiss"};
+
+    for(int b = 0; b < 2; b++) {
+        htable_t *htable = htable_init_backend(2000, backends[b]);
+        if(htable == NULL) {
+            perror("htable_init_backend");
+            exit(EXIT_FAILURE);
+        }
+        double times[2];
+        for(int pass = 0; pass < 2; pass++) {
+            double start = now();
+            for(size_t i = 0; i < words->count; i++) {
+                if(htable_lookup(htable, words->list[i]) == NULL) {
+                    perror("htable_lookup");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            times[pass] = (now() - start) * 1e9 / words->count;
+        }
+        double start = now();
+        uint64_t total = 0;
+        for(htable_iterator_t it = htable_begin(htable); it.ptr != NULL;
+                it = htable_it_next(it))
+            total += it.ptr->data;
+        double iterate = (now() - start) * 1e9 / htable->count;
+        if(total != 2 * words->count) {
+            fputs("wrong sum of the counts\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+        unsigned long unique = htable->count;
+        htable_free(&htable);
+        double batch_times[2];
+        run_batch(backends[b], words, batch_times);
+        printf("%s\t%s\twords=%zu\tunique=%lu\t"
+               "first_ns=%.1f\tsecond_ns=%.1f\t"
+               "first_batch_ns=%.1f\tsecond_batch_ns=%.1f\titerate_ns=%.1f\n",
+               names[b], corpus, words->count, unique,
+               times[0], times[1], batch_times[0], batch_times[1], iterate);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    words_t words = {NULL, 0};
+    char s[MAX_WORD_SIZE];
+
+    for(int i = 1; i < argc; i++) {
+        FILE *file = fopen(argv[i], "r");
+        if(file == NULL) {
+            perror(argv[i]);
+            return EXIT_FAILURE;
+        }
+        while(read_word(s, MAX_WORD_SIZE, file))
+            words_add(&words, s);
+        fclose(file);
+        run(argv[i], &words);
+        words_free(&words);
+    }
+
+    for(unsigned int i = 0; i < UNIQUE_KEYS; i++) {
+        sprintf(s, "key%u", i * 2654435761u);
+        words_add(&words, s);
+    }
+    run("unique", &words);
+    words_free(&words);
+    return 0;
+}
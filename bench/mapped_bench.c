@@ -0,0 +1,122 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Startup and lookup speed of a table snapshot (htable_mapped.h) against
+ * building the table again. The different words of FILE are inserted into a
+ * table, which is saved to SNAPSHOT; then the time to insert them again is
+ * compared with the time to open the snapshot, and the lookups of all the
+ * words in both are timed and checked to give the same counts.
+ *
+ * Usage: bench/mapped_bench FILE SNAPSHOT
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "htable.h"
+#include "htable_mapped.h"
+#include "io.h"
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void die(const char *msg) {
+    perror(msg);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 3) {
+        fputs("Usage: bench/mapped_bench FILE SNAPSHOT\n", stderr);
+        return EXIT_FAILURE;
+    }
+    FILE *file = fopen(argv[1], "r");
+    if(file == NULL)
+        die(argv[1]);
+    tokenizer_t tokenizer;
+    if(tokenizer_open(&tokenizer, file) != 0)
+        die("tokenizer_open");
+    htable_t *htable = htable_init(2000);
+    if(htable == NULL)
+        die("htable_init");
+    const char *word;
+    size_t len;
+    while((word = tokenizer_next(&tokenizer, &len)) != NULL) {
+        if(htable_lookup_len(htable, word, len) == NULL)
+            die("htable_lookup_len");
+    }
+    tokenizer_close(&tokenizer);
+    fclose(file);
+
+    file = fopen(argv[2], "wb");
+    if(file == NULL || !htable_save(htable, file) || fclose(file) != 0)
+        die(argv[2]);
+
+    // what every run without a snapshot does: insert all the keys
+    double start = now();
+    htable_t *rebuilt = htable_init(2000);
+    if(rebuilt == NULL)
+        die("htable_init");
+    for(htable_iterator_t it = htable_begin(htable); it.ptr != NULL;
+            it = htable_it_next(it)) {
+        htable_listitem_t *item =
+            htable_lookup_len(rebuilt, it.ptr->key, it.ptr->len);
+        if(item == NULL)
+            die("htable_lookup_len");
+        item->data = it.ptr->data;
+    }
+    printf("rebuild\tkeys=%lu\tms=%.3f\n", htable->count,
+           (now() - start) * 1e3);
+    htable_free(&rebuilt);
+
+    start = now();
+    htable_mapped_t *mapped = htable_open_mapped(argv[2]);
+    if(mapped == NULL)
+        die(argv[2]);
+    printf("open_mapped\tkeys=%lu\tms=%.3f\n", (unsigned long)mapped->count,
+           (now() - start) * 1e3);
+
+    start = now();
+    for(htable_iterator_t it = htable_begin(htable); it.ptr != NULL;
+            it = htable_it_next(it)) {
+        const htable_mapped_item_t *item =
+            htable_mapped_find(mapped, it.ptr->key, it.ptr->len);
+        if(item == NULL || item->data != it.ptr->data) {
+            fprintf(stderr, "wrong count of '%s'\n", it.ptr->key);
+            return EXIT_FAILURE;
+        }
+    }
+    printf("mapped_find\tkeys=%lu\tns_per_key=%.1f\n", htable->count,
+           (now() - start) * 1e9 / htable->count);
+
+    // the lookups of the same keys in the table itself, for comparison
+    start = now();
+    for(htable_iterator_t it = htable_begin(htable); it.ptr != NULL;
+            it = htable_it_next(it)) {
+        htable_lookup_len(htable, it.ptr->key, it.ptr->len);
+    }
+    printf("htable_lookup\tkeys=%lu\tns_per_key=%.1f\n", htable->count,
+           (now() - start) * 1e9 / htable->count);
+
+    htable_mapped_close(&mapped);
+    htable_free(&htable);
+    return 0;
+}
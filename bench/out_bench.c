@@ -0,0 +1,152 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Throughput of printing "COUNT WORD" lines, the output of wordcount, with
+ * stdio and with the buffered output of out.h. The lines are printed with
+ * printf() (what wordcount used to do), with stdio but without a format
+ * (fputs() of the converted number and of the word), and with out_uint()
+ * and out_write(). Lines of tail are only copied, so they are measured with
+ * fwrite() against out_write().
+ *
+ * Usage: bench/out_bench [LINES] [OUTPUT]
+ *   LINES defaults to 5000000, OUTPUT to /dev/null. The words are "word"
+ *   with a number, the counts follow a Zipfian distribution.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "out.h"
+
+#define WORD_SIZE 16
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void die(const char *msg) {
+    perror(msg);
+    exit(EXIT_FAILURE);
+}
+
+static void report(const char *variant, size_t lines, size_t bytes,
+                   double seconds) {
+    printf("%s\tlines=%zu\tns_per_line=%.1f\tmb_per_s=%.1f\n", variant,
+           lines, seconds * 1e9 / lines, bytes / seconds / 1e6);
+}
+
+int main(int argc, char *argv[]) {
+    size_t lines = (argc > 1) ? strtoul(argv[1], NULL, 10) : 5000000;
+    const char *output = (argc > 2) ? argv[2] : "/dev/null";
+    if(lines == 0) {
+        fputs("Usage: bench/out_bench [LINES] [OUTPUT]\n", stderr);
+        return EXIT_FAILURE;
+    }
+    char (*words)[WORD_SIZE] = malloc(lines * WORD_SIZE);
+    uint64_t *counts = malloc(lines * sizeof(uint64_t));
+    size_t *lengths = malloc(lines * sizeof(size_t));
+    if(words == NULL || counts == NULL || lengths == NULL)
+        die("malloc");
+    size_t bytes = 0;
+    for(size_t i = 0; i < lines; i++) {
+        lengths[i] = snprintf(words[i], WORD_SIZE, "word%zu", i);
+        counts[i] = 10000000 / (i + 1);
+        char number[24];
+        bytes += snprintf(number, sizeof(number), "%" PRIu64, counts[i]) +
+                 lengths[i] + 2;
+    }
+
+    FILE *file = fopen(output, "w");
+    if(file == NULL)
+        die(output);
+    double start = now();
+    for(size_t i = 0; i < lines; i++)
+        fprintf(file, "%" PRIu64 " %s\n", counts[i], words[i]);
+    if(fflush(file) != 0)
+        die(output);
+    report("printf", lines, bytes, now() - start);
+
+    start = now();
+    for(size_t i = 0; i < lines; i++) {
+        char number[24];
+        char *p = number + sizeof(number);
+        *--p = '\0';
+        uint64_t value = counts[i];
+        do {
+            *--p = '0' + value % 10;
+            value /= 10;
+        } while(value > 0);
+        fputs(p, file);
+        putc(' ', file);
+        fputs(words[i], file);
+        putc('\n', file);
+    }
+    if(fflush(file) != 0)
+        die(output);
+    report("stdio_noformat", lines, bytes, now() - start);
+
+    out_t out;
+    if(out_init(&out, fileno(file), OUT_BUFFER) != 0)
+        die("out_init");
+    start = now();
+    for(size_t i = 0; i < lines; i++) {
+        if(out_uint(&out, counts[i]) != 0 || out_char(&out, ' ') != 0 ||
+                out_write(&out, words[i], lengths[i]) != 0 ||
+                out_char(&out, '\n') != 0)
+            die(output);
+    }
+    if(out_flush(&out) != 0)
+        die(output);
+    report("out", lines, bytes, now() - start);
+
+    // whole lines, as tail prints them
+    size_t line_bytes = 0;
+    for(size_t i = 0; i < lines; i++) {
+        size_t len = strlen(words[i]);
+        words[i][len] = '\n';
+        lengths[i] = len + 1;
+        line_bytes += len + 1;
+    }
+    start = now();
+    for(size_t i = 0; i < lines; i++)
+        fwrite(words[i], 1, lengths[i], file);
+    if(fflush(file) != 0)
+        die(output);
+    report("fwrite_lines", lines, line_bytes, now() - start);
+
+    start = now();
+    for(size_t i = 0; i < lines; i++) {
+        if(out_write(&out, words[i], lengths[i]) != 0)
+            die(output);
+    }
+    if(out_flush(&out) != 0)
+        die(output);
+    report("out_lines", lines, line_bytes, now() - start);
+
+    out_free(&out);
+    fclose(file);
+    free(words);
+    free(counts);
+    free(lengths);
+    return 0;
+}
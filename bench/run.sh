@@ -0,0 +1,111 @@
+#!/bin/bash
+# vim: tabstop=4 shiftwidth=4 expandtab
+#
+# The benchmark suite run by `make bench`. Generates uniform, Zipfian and
+# long-key corpora (see bench/gen_corpus.c) and measures on them:
+#
+#   htable     ns per lookup of a new key (first_ns, a miss and an insert)
+#              and of a key already in the table (second_ns, a hit), also
+#              with htable_lookup_batch() (first_batch_ns, second_batch_ns),
+#              and of iterating the table, per key (iterate_ns)
+#   tokenizer  bytes per second split into words
+#   output     lines printed per second with stdio and with out.h
+#   wordcount  the time of `wordcount` and `wordcount-static`
+#   tail       the time of `tail` on files of 1 MB to 128 MB
+#
+# Every result is one line of tab-separated fields: the suite, the variant,
+# the input and then NAME=VALUE pairs. The lines are always in the same
+# order, so the results of two commits can be compared with
+# bench/compare.sh.
+#
+# Usage: bench/run.sh
+#   Run from the top directory, after `make all static` and the benchmark
+#   programs. BENCH_WORDS sets the number of words of each corpus (2000000
+#   by default), BENCH_REPEAT how many times each command is timed, taking
+#   the fastest (3), and BENCH_DIR where the corpora are kept between runs
+#   (bench/corpora).
+#
+# Copyright 2009 Martina Kollarova
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+set -e
+WORDS=${BENCH_WORDS:-2000000}
+REPEAT=${BENCH_REPEAT:-3}
+DIR=${BENCH_DIR:-bench/corpora}
+CORPORA="uniform zipf long"
+TAIL_SIZES="1 16 128"
+OUT=$(mktemp -d)
+trap "rm -rf $OUT" EXIT
+mkdir -p $DIR
+
+# the corpora don't change, so they are only generated once
+for CORPUS in $CORPORA; do
+    FILE=$DIR/$CORPUS-$WORDS.txt
+    [ -s $FILE ] || bench/gen_corpus $CORPUS $WORDS > $FILE
+done
+for SIZE in $TAIL_SIZES; do
+    FILE=$DIR/tail-${SIZE}MB.txt
+    if [ ! -s $FILE ]; then
+        bench/gen_corpus uniform $((SIZE * 1024 * 1024 / 8)) |
+            head -c $((SIZE * 1024 * 1024)) > $FILE
+    fi
+done
+
+# best_ms COMMAND: the fastest wall time of the command given as a string,
+# in milliseconds
+function best_ms {
+    local best=
+    for i in $(seq $REPEAT); do
+        local start=$(date +%s%N)
+        bash -c "$1" > $OUT/output
+        local end=$(date +%s%N)
+        local time=$(((end - start) / 1000))
+        if [ -z "$best" ] || [ $time -lt $best ]; then best=$time; fi
+    done
+    printf "%d.%03d" $((best / 1000)) $((best % 1000))
+}
+
+FILES=
+for CORPUS in $CORPORA; do FILES="$FILES $DIR/$CORPUS-$WORDS.txt"; done
+
+bench/htable_bench $FILES | sed -e "s|$DIR/||" -e 's/^/htable\t/'
+
+for CORPUS in $CORPORA; do
+    bench/tokenizer_bench $DIR/$CORPUS-$WORDS.txt 4 |
+        sed -e "s/^\([^\t]*\)\t/\1\t$CORPUS-$WORDS.txt\t/" -e 's/^/tokenizer\t/'
+done
+
+bench/out_bench $WORDS |
+    sed -e "s/^\([^\t]*\)\t/output\t\1\t$WORDS-lines\t/"
+
+for CORPUS in $CORPORA; do
+    FILE=$DIR/$CORPUS-$WORDS.txt
+    for PROGRAM in wordcount wordcount-static; do
+        printf "wordcount\t%s\t%s\tms=%s\n" $PROGRAM $CORPUS-$WORDS.txt \
+            $(best_ms "./$PROGRAM $FILE")
+        cp $OUT/output $OUT/$PROGRAM
+    done
+    cmp -s $OUT/wordcount $OUT/wordcount-static ||
+        echo "different output of wordcount and wordcount-static" >&2
+done
+
+for SIZE in $TAIL_SIZES; do
+    FILE=$DIR/tail-${SIZE}MB.txt
+    printf "tail\tlast_lines\t%s\tms=%s\n" ${SIZE}MB \
+        $(best_ms "./tail -10 $FILE")
+    printf "tail\tlast_lines_pipe\t%s\tms=%s\n" ${SIZE}MB \
+        $(best_ms "cat $FILE | ./tail -10")
+    printf "tail\tfrom_line\t%s\tms=%s\n" ${SIZE}MB \
+        $(best_ms "./tail +2 $FILE")
+done
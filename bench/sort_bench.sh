@@ -0,0 +1,61 @@
+#!/bin/bash
+# vim: tabstop=4 shiftwidth=4 expandtab
+#
+# Compare `wordcount --top K` and `wordcount --sort count|key` with piping
+# the output of `wordcount` into sort(1). Prints the wall time of each
+# variant in seconds and checks that both give the same output.
+#
+# Usage: bench/sort_bench.sh FILE [K]
+#   Run from the top directory, after `make`. K defaults to 10.
+#
+# Copyright 2009 Martina Kollarova
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 FILE [K]" >&2
+    exit 1
+fi
+FILE=$1
+K=${2:-10}
+CMD=./wordcount
+OUT=$(mktemp -d)
+trap "rm -rf $OUT" EXIT
+
+# sort compares the words byte by byte, like wordcount
+export LC_ALL=C
+
+# run NAME OUTPUT COMMAND: time the command given as a string
+function run {
+    local start=$(date +%s%N)
+    bash -c "$3" > $OUT/$2
+    local end=$(date +%s%N)
+    printf "%s\tseconds=%d.%03d\n" $1 $(((end - start) / 1000000000)) \
+        $(((end - start) / 1000000 % 1000))
+}
+
+# compare OUTPUT OUTPUT
+function compare {
+    cmp -s $OUT/$1 $OUT/$2 || echo "different output of $1 and $2" >&2
+}
+
+run count_only plain "$CMD $FILE"
+run top_pipeline top_pipe "$CMD $FILE | sort -k1,1nr -k2,2 | head -$K"
+run top_builtin top "$CMD --top $K $FILE"
+compare top_pipe top
+run sort_count_pipeline count_pipe "$CMD $FILE | sort -k1,1nr -k2,2"
+run sort_count_builtin count "$CMD --sort count $FILE"
+compare count_pipe count
+run sort_key_pipeline key_pipe "$CMD $FILE | sort -k2,2"
+run sort_key_builtin key "$CMD --sort key $FILE"
+compare key_pipe key
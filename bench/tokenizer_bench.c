@@ -0,0 +1,131 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Throughput of the tokenizer with each implementation of the whitespace
+ * scanning (scalar, SSE2, AVX2), compared with read_word(). The file is
+ * replicated in memory to get a large input. Before measuring, every
+ * implementation is checked to split the file into exactly the same words as
+ * read_word().
+ *
+ * Usage: bench/tokenizer_bench FILE [COPIES]
+ *   COPIES defaults to 200 (about 135 MB for tests/files/book.txt).
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "io.h"
+#include "scan.h"
+
+#define MAX_WORD_SIZE (1024 * 1024)
+
+static const char *names[] = {"scalar", "sse2", "avx2"};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void die(const char *msg) {
+    perror(msg);
+    exit(EXIT_FAILURE);
+}
+
+/* Check that the tokenizer gives the same words as read_word(). */
+static void verify(const char *filename, const char *data, size_t size) {
+    FILE *file = fopen(filename, "r");
+    char *word = malloc(MAX_WORD_SIZE);
+    if(file == NULL || word == NULL)
+        die(filename);
+    tokenizer_t tokenizer;
+    tokenizer_init_memory(&tokenizer, data, size);
+    const char *token;
+    size_t len;
+    while((token = tokenizer_next(&tokenizer, &len)) != NULL) {
+        if(read_word(word, MAX_WORD_SIZE, file) != (int)len ||
+                memcmp(word, token, len) != 0) {
+            fprintf(stderr, "%s: different word at offset %zu\n",
+                    names[scan_selected()], (size_t)(token - data));
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(read_word(word, MAX_WORD_SIZE, file) != 0) {
+        fprintf(stderr, "%s: missing words\n", names[scan_selected()]);
+        exit(EXIT_FAILURE);
+    }
+    free(word);
+    fclose(file);
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        fputs("Usage: bench/tokenizer_bench FILE [COPIES]\n", stderr);
+        return EXIT_FAILURE;
+    }
+    size_t copies = argc > 2 ? strtoul(argv[2], NULL, 10) : 200;
+
+    FILE *file = fopen(argv[1], "r");
+    if(file == NULL)
+        die(argv[1]);
+    fseek(file, 0, SEEK_END);
+    size_t size = ftell(file);
+    rewind(file);
+    char *data = malloc(size * copies + 1);
+    if(data == NULL)
+        die("malloc");
+    if(fread(data, 1, size, file) != size)
+        die("fread");
+    fclose(file);
+    for(size_t i = 1; i < copies; i++)
+        memcpy(data + i * size, data, size);
+
+    // read_word() on a single copy, it's much slower
+    file = fopen(argv[1], "r");
+    char *word = malloc(MAX_WORD_SIZE);
+    if(file == NULL || word == NULL)
+        die(argv[1]);
+    double start = now();
+    while(read_word(word, MAX_WORD_SIZE, file)) {}
+    printf("read_word\tbytes=%zu\tgbps=%.3f\n", size,
+           size / (now() - start) / 1e9);
+    free(word);
+    fclose(file);
+
+    scan_impl_t best = scan_selected();
+    for(int impl = SCAN_SCALAR; impl <= SCAN_AVX2; impl++) {
+        if(!scan_select(impl)) {
+            printf("%s\tnot supported\n", names[impl]);
+            continue;
+        }
+        verify(argv[1], data, size);
+
+        tokenizer_t tokenizer;
+        tokenizer_init_memory(&tokenizer, data, size * copies);
+        size_t words = 0, len;
+        start = now();
+        while(tokenizer_next(&tokenizer, &len) != NULL)
+            words++;
+        double elapsed = now() - start;
+        printf("%s\tbytes=%zu\twords=%zu\tgbps=%.3f\n", names[impl],
+               size * copies, words, size * copies / elapsed / 1e9);
+    }
+    scan_select(best);
+    free(data);
+    return 0;
+}
@@ -0,0 +1,101 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+// alignment of the memory returned by arena_alloc()
+#define ARENA_ALIGN sizeof(void *)
+
+
+void arena_init(arena_t *arena, size_t block_size) {
+    arena->blocks = NULL;
+    arena->used = 0;
+    arena->block_size = block_size;
+}
+
+void arena_free(arena_t *arena) {
+    while(arena->blocks != NULL) {
+        arena_block_t *tmp = arena->blocks;
+        arena->blocks = arena->blocks->next;
+        free(tmp);
+    }
+    arena->used = 0;
+}
+
+/* Get 'size' bytes from the first block, starting at offset 'start'. If
+ * there is not enough space, allocate a new block. */
+static void * arena_take(arena_t *arena, size_t start, size_t size) {
+    if(size > arena->block_size / 4) {
+        // big requests get their own block, which is put after the first
+        // one, so that the first block can still be filled up
+        arena_block_t *block = malloc(sizeof(arena_block_t) + size);
+        if(block == NULL)
+            return NULL;
+        block->size = size;
+        if(arena->blocks == NULL) {
+            block->next = NULL;
+            arena->blocks = block;
+            arena->used = size;
+        }
+        else {
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        }
+        return block->data;
+    }
+
+    if(arena->blocks == NULL || start + size > arena->blocks->size) {
+        arena_block_t *block = malloc(sizeof(arena_block_t) +
+                                      arena->block_size);
+        if(block == NULL)
+            return NULL;
+        block->size = arena->block_size;
+        block->next = arena->blocks;
+        arena->blocks = block;
+        start = 0;
+    }
+    arena->used = start + size;
+    return arena->blocks->data + start;
+}
+
+void * arena_alloc(arena_t *arena, size_t size) {
+    size_t start = (arena->used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    return arena_take(arena, start, size);
+}
+
+char * arena_strdup(arena_t *arena, const char *str) {
+    return arena_strndup(arena, str, strlen(str));
+}
+
+char * arena_strndup(arena_t *arena, const char *str, size_t len) {
+    char *copy = arena_take(arena, arena->used, len + 1);
+    if(copy != NULL) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+size_t arena_size(const arena_t *arena) {
+    size_t size = 0;
+    for(const arena_block_t *block = arena->blocks; block != NULL;
+            block = block->next)
+        size += sizeof(arena_block_t) + block->size;
+    return size;
+}
@@ -0,0 +1,74 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Arena allocator - small objects are carved out of large blocks and are all
+ * freed at once, together with the arena.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+
+typedef struct arena                arena_t;
+typedef struct arena_block          arena_block_t;
+
+
+struct arena {
+    arena_block_t *blocks;  // the block being filled is the first one
+    size_t used;            // bytes used in the first block
+    size_t block_size;
+};
+
+struct arena_block {
+    arena_block_t *next;
+    size_t size;
+    char data[];
+};
+
+
+/**
+ * Initialize an empty arena, no memory is allocated until the first
+ * arena_alloc().
+ * @param block_size  Size of the blocks that will be allocated.
+ */
+void arena_init(arena_t *arena, size_t block_size);
+
+/* Free all the blocks, and so all the memory allocated from the arena. */
+void arena_free(arena_t *arena);
+
+/**
+ * Allocate 'size' bytes, aligned for any pointer or integer type. Requests
+ * larger than a quarter of the block size get a block of their own.
+ * @return  Pointer to the memory or NULL if malloc failed.
+ */
+void * arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * Copy the string into the arena. The copy is not aligned, so that short
+ * strings can be packed tightly.
+ * @return  Pointer to the copy or NULL if malloc failed.
+ */
+char * arena_strdup(arena_t *arena, const char *str);
+
+/* Same as arena_strdup(), but copies only 'len' bytes and adds '\0'. */
+char * arena_strndup(arena_t *arena, const char *str, size_t len);
+
+/* Number of bytes allocated by the arena, including the unused space at the
+ * end of its blocks. */
+size_t arena_size(const arena_t *arena);
+
+#endif /* __ARENA_H__ */
@@ -17,9 +17,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <assert.h>
+#include <limits.h>
+#include <errno.h>
 
 #include "htable.h"
+#include "htable_internal.h"
 
 /*
  * The hash table consists of one integer showing its size and a fixed array of
@@ -40,109 +42,396 @@
  *   +-------------+
  *   |htable_list_t|--|
  *   +-------------+
+ *
+ * When the number of keys exceeds 'max_load' times the size, the array is
+ * doubled. Moving all the items at once would stall that one lookup, so the
+ * old array is kept around and every following lookup moves a few of its
+ * lists (and always the list of the key it is looking for) into the new one.
+ * The items are appended to the new lists in their original order, so a list
+ * always keeps its keys in the order in which they were first inserted.
+ *
+ * Items are never removed from the table one by one, so instead of calling
+ * malloc twice for every new key (once for the item and once for the string),
+ * the items are stored one after another, in the order of insertion, in
+ * pages of HTABLE_PAGE items, and the keys are carved out of large blocks
+ * (see arena.h) where they are packed without any padding. The lists (or the
+ * slots of HTABLE_SWISS) only point into the pages, which never move, so an
+ * item can still be returned by pointer. Iterating the table is a linear scan
+ * of the pages, which doesn't touch the lists at all: a sparse table costs
+ * nothing for its empty lists, and the items are read in the order in which
+ * they lie in memory. The keys are in the same order in the arena as well.
+ * Freeing the table only frees the pages and the blocks.
  */
 
+// Number of lists moved from the old array during one lookup.
+#define HTABLE_REHASH_STEP 4
+
+// Size of the blocks from which the keys are allocated.
+#define HTABLE_ARENA_BLOCK (64 * 1024)
+
+// Initial size of the array of pages of items.
+#define HTABLE_PAGES 16
+
+// Number of keys hashed and prefetched together by htable_lookup_batch().
+#define HTABLE_BATCH 16
+
 htable_t * htable_init(unsigned int size) {
+    return htable_init_backend(size, HTABLE_CHAINED);
+}
+
+htable_t * htable_init_backend(unsigned int size, htable_backend_t backend) {
     // alloc space for the table
     htable_t *htable = malloc(sizeof(htable_t));
     if(htable == NULL)
         return NULL;
 
-    // alloc an array of pointers, pointing to lists
-    htable->list = (htable_list_t *)calloc(size, sizeof(htable_list_t));
-    if(htable->list == NULL) {
-        free(htable);
-        return NULL;
+    htable->backend = backend;
+    htable->list = NULL;
+    htable->ctrl = NULL;
+    htable->slots = NULL;
+    if(backend == HTABLE_SWISS) {
+        if(!htable_swiss_init(htable, size)) {
+            free(htable);
+            return NULL;
+        }
+    }
+    else {
+        // alloc an array of pointers, pointing to lists
+        htable->list = (htable_list_t *)calloc(size, sizeof(htable_list_t));
+        if(htable->list == NULL) {
+            free(htable);
+            return NULL;
+        }
+        htable->size = size;
     }
-    htable->size = size;
+    htable->count = 0;
+    htable->max_load = HTABLE_DEFAULT_MAX_LOAD;
+    htable->hash = htable_hash_wyhash;
+    htable->index = HTABLE_MODULO;
+    htable->old_list = NULL;
+    htable->old_size = 0;
+    htable->rehash_index = 0;
+    htable->lookups = 0;
+    htable->probes = 0;
+    htable->max_probes = 0;
+    htable->pages = NULL;
+    htable->page_count = 0;
+    htable->page_capacity = 0;
+    arena_init(&htable->keys, HTABLE_ARENA_BLOCK);
     return htable;
 }
 
-/* Free space after keys and items */
-static void htable_clear(htable_t *htable) {
-    for(unsigned int i = 0; i < htable->size; i++) {
-        if(htable->list[i].head == NULL || htable->list[i].tail == NULL) {
-            assert(htable->list[i].head == NULL &&
-                   htable->list[i].tail == NULL);
-            continue;
-        }
-        // cycle trough the list and free its items
-        while (htable->list[i].head != NULL) {
-            htable_listitem_t *tmp;
-            tmp = htable->list[i].head;
-
-            htable->list[i].head = htable->list[i].head->next;
-            free(tmp->key);
-            free(tmp);
+void htable_set_max_load(htable_t *htable, double max_load) {
+    htable->max_load = max_load;
+}
+
+bool htable_set_hash(htable_t *htable, htable_hash_t hash,
+                     htable_index_t index) {
+    if(htable->count != 0)
+        return false;
+    if(htable->backend == HTABLE_CHAINED && index == HTABLE_MASK) {
+        unsigned int size = 1;
+        while(size < htable->size && size <= UINT_MAX / 2)
+            size *= 2;
+        if(size != htable->size) {
+            htable_list_t *list = calloc(size, sizeof(htable_list_t));
+            if(list == NULL)
+                return false;
+            free(htable->list);
+            htable->list = list;
+            htable->size = size;
         }
     }
+    htable->hash = hash;
+    htable->index = index;
+    return true;
+}
+
+uint64_t htable_hash(const htable_t *htable, const char *key, size_t len) {
+    return htable->hash(key, len);
+}
+
+unsigned int htable_index(const htable_t *htable, uint64_t hash,
+                          unsigned int size) {
+    if(htable->index == HTABLE_MASK)
+        return hash & (size - 1);
+    return hash % size;
 }
 
 void htable_free(htable_t **htable) {
-    htable_clear(*htable);
+    for(unsigned long i = 0; i < (*htable)->page_count; i++)
+        free((*htable)->pages[i]);
+    free((*htable)->pages);
+    arena_free(&(*htable)->keys);
+    free((*htable)->old_list);
     free((*htable)->list);
+    free((*htable)->ctrl);
+    free((*htable)->slots);
     free(*htable);
     *htable = NULL;
 }
 
-htable_listitem_t * htable_lookup(htable_t *htable, const char *key) {
-    htable_listitem_t *result = NULL;
-    unsigned int i = htable_hash_function(key, htable->size);
-    bool found = false;
-    htable_listitem_t *tmp;
-    tmp = htable->list[i].head;
+/* Move all items from one list of the old array into the new array. */
+static void htable_rehash_list(htable_t *htable, unsigned int old_index) {
+    htable_list_t *old = &htable->old_list[old_index];
+    htable_listitem_t *item;
+    while((item = htable_list_pop(old)) != NULL) {
+        unsigned int i = htable_index(htable,
+                                      htable_hash(htable, item->key, item->len),
+                                      htable->size);
+        htable_list_append(&htable->list[i], item);
+    }
+}
+
+/* Move the next few lists of the old array, free it once it's empty. */
+static void htable_rehash_step(htable_t *htable) {
+    for(int n = 0; n < HTABLE_REHASH_STEP &&
+            htable->rehash_index < htable->old_size; n++) {
+        htable_rehash_list(htable, htable->rehash_index++);
+    }
+    if(htable->rehash_index == htable->old_size) {
+        free(htable->old_list);
+        htable->old_list = NULL;
+        htable->old_size = 0;
+        htable->rehash_index = 0;
+    }
+}
+
+/* Double the size of the table. If malloc fails, the table just stays as it
+ * is, since it still works (only slower). */
+static void htable_grow(htable_t *htable) {
+    // the previous growth didn't finish yet (happens with small 'max_load')
+    while(htable->old_list != NULL)
+        htable_rehash_step(htable);
+
+    if(htable->size > UINT_MAX / 2)
+        return;
+    htable_list_t *list = calloc(htable->size * 2, sizeof(htable_list_t));
+    if(list == NULL)
+        return;
+    htable->old_list = htable->list;
+    htable->old_size = htable->size;
+    htable->rehash_index = 0;
+    htable->list = list;
+    htable->size *= 2;
+}
+
+/* Allocate the page for the next HTABLE_PAGE items. */
+static bool htable_add_page(htable_t *htable) {
+    if(htable->page_count == htable->page_capacity) {
+        unsigned long capacity = htable->page_capacity
+                                 ? htable->page_capacity * 2 : HTABLE_PAGES;
+        htable_listitem_t **pages = realloc(htable->pages,
+                                            capacity * sizeof(*pages));
+        if(pages == NULL)
+            return false;
+        htable->pages = pages;
+        htable->page_capacity = capacity;
+    }
+    htable_listitem_t *page = malloc(HTABLE_PAGE * sizeof(htable_listitem_t));
+    if(page == NULL)
+        return false;
+    htable->pages[htable->page_count++] = page;
+    return true;
+}
+
+htable_listitem_t * htable_new_item(htable_t *htable, const char *key,
+                                    size_t len) {
+    // the page can be there already, if copying the key failed last time
+    if(htable->count / HTABLE_PAGE == htable->page_count &&
+            !htable_add_page(htable))
+        return NULL;
+    htable_listitem_t *item = htable_item_at(htable, htable->count);
+    item->key = arena_strndup(&htable->keys, key, len);
+    if(item->key == NULL)
+        return NULL;
+    item->data = 1;
+    item->len = len;
+    item->next = NULL;
+    return item;
+}
+
+/* htable_lookup_len() with the hash of the key already computed. */
+static htable_listitem_t * htable_lookup_hash(htable_t *htable,
+                                              const char *key, size_t len,
+                                              uint64_t hash) {
+    if(htable->backend == HTABLE_SWISS)
+        return htable_swiss_lookup(htable, key, len, hash);
+
+    if(htable->old_list != NULL) {
+        // make sure the key isn't left behind in the old array
+        htable_rehash_list(htable,
+                           htable_index(htable, hash, htable->old_size));
+        htable_rehash_step(htable);
+    }
+    htable_list_t *list = &htable->list[htable_index(htable, hash,
+                                                     htable->size)];
 
     // search for the key, if found, increase its count and return the item
-    while(htable->list[i].head != NULL) {
-        if(strcmp(htable->list[i].head->key, key) == 0) {
-            htable->list[i].head->data++;
-            result = htable->list[i].head;
-            found = true;
-            break;
-        }
-        htable->list[i].head = htable->list[i].head->next;
+    unsigned long probes = 0;
+    htable_str_t str = {key, len};
+    htable_listitem_t *item = htable_list_find(list, str, &probes);
+    HTABLE_COUNT_PROBES(htable, probes);
+    if(item != NULL) {
+        item->data++;
+        return item;
     }
-    htable->list[i].head = tmp;
 
-    if(!found) {
-        htable_listitem_t *tmp = NULL;
-        if(htable->list[i].tail != NULL) { // if this is not the first item
-            tmp = htable->list[i].tail;
-        }
+    item = htable_new_item(htable, key, len);
+    if(item == NULL)
+        return NULL;
+    htable_list_append(list, item);
 
-        // alloc space for one listitem
-        htable->list[i].tail = (htable_listitem_t *)
-                                malloc(sizeof(htable_listitem_t));
-        if(htable->list[i].tail == NULL)
-            return NULL;
+    htable->count++;
+    if(htable->max_load > 0 &&
+            htable->count > htable->max_load * htable->size) {
+        htable_grow(htable);
+    }
+    return item;
+}
+
+htable_listitem_t * htable_lookup(htable_t *htable, const char *key) {
+    return htable_lookup_len(htable, key, strlen(key));
+}
+
+htable_listitem_t * htable_lookup_len(htable_t *htable, const char *key,
+                                      size_t len) {
+    if(len > UINT_MAX) {
+        errno = EOVERFLOW;
+        return NULL;
+    }
+    return htable_lookup_hash(htable, key, len, htable_hash(htable, key, len));
+}
 
-        // alloc space for the string
-        htable->list[i].tail->key = (char *)
-                                     malloc((strlen(key) + 1) * sizeof(char));
-        strcpy(htable->list[i].tail->key, key);
+htable_listitem_t * htable_find(const htable_t *htable, const char *key,
+                                size_t len) {
+    if(len > UINT_MAX)
+        return NULL;
+    uint64_t hash = htable_hash(htable, key, len);
+    if(htable->backend == HTABLE_SWISS)
+        return htable_swiss_find(htable, key, len, hash);
 
-        htable->list[i].tail->data = 1;
-        htable->list[i].tail->next = NULL;
+    unsigned long probes = 0;
+    htable_str_t str = {key, len};
+    htable_listitem_t *item = NULL;
+    if(htable->old_list != NULL) {
+        // the key's list wasn't moved yet, otherwise it's empty
+        item = htable_list_find(&htable->old_list[htable_index(htable, hash,
+                                htable->old_size)], str, &probes);
+    }
+    if(item == NULL) {
+        item = htable_list_find(&htable->list[htable_index(htable, hash,
+                                htable->size)], str, &probes);
+    }
+    return item;
+}
 
-        result = htable->list[i].tail;
+/*
+ * The lookups are done in groups of HTABLE_BATCH keys, in three passes over
+ * the group: the keys are hashed and the lists where they belong are
+ * prefetched; then the first items of the lists are prefetched, when the
+ * lists are likely in the cache already; and then the keys are looked up one
+ * by one as usual, only with their hashes computed. A lookup can grow the
+ * table, so the lists are only a guess for the following keys of the group,
+ * but htable_lookup_hash() finds the right ones anyway.
+ */
+bool htable_lookup_batch(htable_t *htable, const htable_str_t *keys,
+                         size_t n, htable_listitem_t **results) {
+    uint64_t hashes[HTABLE_BATCH];
+    for(size_t i = 0; i < n; i++)
+        results[i] = NULL;
 
-        if(tmp != NULL) {
-            // reconnect the previous item
-            tmp->next = htable->list[i].tail;
+    for(size_t start = 0; start < n; start += HTABLE_BATCH) {
+        size_t count = (n - start < HTABLE_BATCH) ? n - start : HTABLE_BATCH;
+        const htable_str_t *batch = keys + start;
+        for(size_t i = 0; i < count; i++) {
+            if(batch[i].len > UINT_MAX) {
+                errno = EOVERFLOW;
+                return false;
+            }
+            hashes[i] = htable_hash(htable, batch[i].str, batch[i].len);
+            if(htable->backend == HTABLE_SWISS)
+                htable_swiss_prefetch(htable, hashes[i]);
+            else
+                __builtin_prefetch(&htable->list[htable_index(htable,
+                                   hashes[i], htable->size)]);
+        }
+        if(htable->backend == HTABLE_CHAINED) {
+            for(size_t i = 0; i < count; i++) {
+                htable_listitem_t *head = htable->list[htable_index(htable,
+                                          hashes[i], htable->size)].head;
+                if(head != NULL)
+                    __builtin_prefetch(head);
+            }
         }
-        else {
-            // if this is the first item in the list, set htable = tail = item
-            htable->list[i].head = htable->list[i].tail;
+        for(size_t i = 0; i < count; i++) {
+            results[start + i] = htable_lookup_hash(htable, batch[i].str,
+                                                    batch[i].len, hashes[i]);
+            if(results[start + i] == NULL)
+                return false;
         }
     }
-    return result;
+    return true;
 }
 
-unsigned int htable_hash_function(const char *key, unsigned int htable_size) {
-    unsigned long int h = 0;
-    unsigned char *p;
+bool htable_merge(htable_t *dst, htable_t *src) {
+    for(htable_iterator_t iterator = htable_begin(src);
+            iterator.ptr != NULL;
+            iterator = htable_it_next(iterator)) {
+        htable_listitem_t *item = htable_lookup_len(dst, iterator.ptr->key,
+                                                    iterator.ptr->len);
+        if(item == NULL)
+            return false;
+        // the lookup already counted one occurrence
+        item->data += iterator.ptr->data - 1;
+    }
+    return true;
+}
+
+/* Add the lengths of the lists of one array to the histogram. */
+static void htable_list_stats(const htable_list_t *list, unsigned int size,
+                              htable_stats_t *stats) {
+    for(unsigned int i = 0; i < size; i++) {
+        unsigned long length = 0;
+        for(htable_listitem_t *item = list[i].head; item != NULL;
+                item = item->next)
+            length++;
+        stats->lengths[length < HTABLE_STATS_LENGTHS
+                       ? length : HTABLE_STATS_LENGTHS - 1]++;
+        if(length > stats->max_length)
+            stats->max_length = length;
+    }
+}
+
+void htable_stats(const htable_t *htable, htable_stats_t *stats) {
+    memset(stats, 0, sizeof(htable_stats_t));
+    stats->backend = htable->backend;
+    stats->count = htable->count;
+    stats->size = htable->size;
+    stats->load_factor = htable->size ? (double)htable->count / htable->size
+                                      : 0.0;
+#ifdef HTABLE_STATS
+    stats->probes_counted = true;
+#endif
+    stats->lookups = htable->lookups;
+    stats->average_probes = htable->lookups
+                            ? (double)htable->probes / htable->lookups : 0.0;
+    stats->max_probes = htable->max_probes;
+    stats->item_bytes = htable->page_count * HTABLE_PAGE *
+                        sizeof(htable_listitem_t) +
+                        htable->page_capacity * sizeof(htable_listitem_t *);
+    stats->key_bytes = arena_size(&htable->keys);
 
-    for(p=(unsigned char*)key; *p!='\0'; p++)
-        h = 31*h + *p;
-    return h % htable_size;
+    if(htable->backend == HTABLE_SWISS) {
+        htable_swiss_stats(htable, stats);
+        return;
+    }
+    // while growing, the lists not moved yet are still in the old array
+    htable_list_stats(htable->list, htable->size, stats);
+    stats->table_bytes = htable->size * sizeof(htable_list_t);
+    if(htable->old_list != NULL) {
+        htable_list_stats(htable->old_list + htable->rehash_index,
+                          htable->old_size - htable->rehash_index, stats);
+        stats->table_bytes += htable->old_size * sizeof(htable_list_t);
+    }
 }
@@ -20,65 +20,254 @@
 #define __HTABLE_H__
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+#include "htable_generic.h"
 
 
 typedef struct htable               htable_t;
 typedef struct htable_iterator      htable_iterator_t;
-typedef struct htable_list          htable_list_t;
 typedef struct htable_listitem      htable_listitem_t;
+typedef struct htable_stats         htable_stats_t;
+typedef struct htable_str           htable_str_t;
+
+
+/* How the table stores its items. */
+typedef enum htable_backend {
+    // array of linked lists, see htable.c
+    HTABLE_CHAINED,
+    // open addressing with an array of 1-byte fingerprints scanned 16 at a
+    // time, see htable_swiss.c
+    HTABLE_SWISS,
+} htable_backend_t;
+
+/* Hash function of the keys, gets the key and its length (without '\0'). */
+typedef uint64_t (*htable_hash_t)(const char *key, size_t len);
+
+/* How the hash of a key is reduced to an index of a list. */
+typedef enum htable_index {
+    HTABLE_MODULO,  // hash % size, for any size
+    HTABLE_MASK,    // hash & (size - 1), the size is a power of two
+} htable_index_t;
+
+struct htable_listitem {
+    char *key;
+    uint64_t data;          // the count, 64 bits so that it can't overflow
+    unsigned int len;       // length of the key, without '\0'
+    htable_listitem_t *next;
+};
+
+/* A key given by its length, it doesn't have to end with '\0'. */
+struct htable_str {
+    const char *str;
+    size_t len;
+};
+
+/* Whether the keys are equal. */
+static inline bool htable_str_eq(htable_str_t a, htable_str_t b) {
+    return a.len == b.len && memcmp(a.str, b.str, a.len) == 0;
+}
 
+/* Whether the item has the key. */
+static inline bool htable_listitem_eq(const htable_listitem_t *item,
+                                      htable_str_t key) {
+    return item->len == key.len && memcmp(item->key, key.str, key.len) == 0;
+}
+
+/* htable_list_t: a list of items in the order of insertion, see htable.c. */
+HTABLE_DEFINE_CHAINED(htable, htable_listitem_t, htable_str_t,
+                      htable_listitem_eq)
+
+/* Grow the table when there are more keys than (max_load * size). */
+#define HTABLE_DEFAULT_MAX_LOAD 1.0
 
 struct htable {
-    unsigned int size;
+    htable_backend_t backend;
+    unsigned int size;      // number of lists, or slots for HTABLE_SWISS
     htable_list_t *list;
+    unsigned long count;    // number of keys in the table
+    double max_load;
+    htable_hash_t hash;
+    htable_index_t index;
+    // While the table grows, the items are moved from the previous (smaller)
+    // array of lists a few lists at a time, see htable_lookup(). All the
+    // lists in 'old_list' before 'rehash_index' are already moved.
+    htable_list_t *old_list;
+    unsigned int old_size;
+    unsigned int rehash_index;
+    // the items in the order of insertion, in pages of HTABLE_PAGE items
+    // that never move, and the arena of their keys, see htable.c
+    htable_listitem_t **pages;
+    unsigned long page_count;       // pages allocated
+    unsigned long page_capacity;    // size of the 'pages' array
+    arena_t keys;
+    // HTABLE_SWISS only: a control byte (fingerprint of the key, or empty)
+    // and a pointer to the item, for each slot
+    unsigned char *ctrl;
+    htable_listitem_t **slots;
+    // number of lookups and of the keys (groups for HTABLE_SWISS) compared
+    // during them, only counted if compiled with HTABLE_STATS
+    unsigned long lookups;
+    unsigned long probes;
+    unsigned long max_probes;
 };
 
 struct htable_iterator {
     htable_t *htable;
-    unsigned int index;
+    unsigned long index;    // position of the item in the order of insertion
     htable_listitem_t *ptr;
 };
 
-struct htable_list {
-    htable_listitem_t *head;
-    htable_listitem_t *tail;
-};
+// lengths in the histogram of htable_stats_t, the last one is "or more"
+#define HTABLE_STATS_LENGTHS 8
 
-struct htable_listitem {
-    char *key;
-    unsigned int data;
-    htable_listitem_t *next;
+struct htable_stats {
+    htable_backend_t backend;
+    unsigned long count;
+    unsigned int size;
+    double load_factor;     // count / size
+    // HTABLE_CHAINED: the number of lists of each length; HTABLE_SWISS: the
+    // number of keys found in the group where their search starts (length
+    // 0), the next group (1), and so on
+    unsigned long lengths[HTABLE_STATS_LENGTHS];
+    unsigned long max_length;
+    // false if the library was compiled without HTABLE_STATS, the numbers of
+    // lookups and probes are 0 then
+    bool probes_counted;
+    unsigned long lookups;
+    double average_probes;
+    unsigned long max_probes;
+    // memory allocated for the lists or slots, the items and the keys
+    size_t table_bytes;
+    size_t item_bytes;
+    size_t key_bytes;
 };
 
 
 /**
  * Allocate space for the hash table.
- * @param size  Desired size of the table, recommended is 2000.
+ * @param size  Initial size of the table, recommended is 2000. The table
+ *      doubles its size when the load factor is exceeded.
  * @return  Pointer to the created table or NULL if malloc failed.
  */
 htable_t * htable_init(unsigned int size);
 
-/* Free space after table and all its contents. */
+/**
+ * Same as htable_init(), but the table will use the given backend. Both
+ * backends behave the same from the outside, including the order of
+ * iteration. A HTABLE_SWISS table rounds its size up to a power of two.
+ */
+htable_t * htable_init_backend(unsigned int size, htable_backend_t backend);
+
+/**
+ * Set the load factor (keys per list) above which the table grows. Use 0 to
+ * keep the size fixed. The default is HTABLE_DEFAULT_MAX_LOAD. Ignored by
+ * HTABLE_SWISS tables, which always grow when they are 7/8 full.
+ */
+void htable_set_max_load(htable_t *htable, double max_load);
+
+/* Free space after table and all its contents, including the keys. */
 void htable_free(htable_t **htable);
 
+/**
+ * Change the hash function of the table (the default is htable_hash_wyhash()
+ * with HTABLE_MODULO). With HTABLE_MASK, the size of a HTABLE_CHAINED table is
+ * rounded up to a power of two; HTABLE_SWISS tables always use a mask.
+ * @return  false if the table isn't empty or malloc failed, in which case
+ *      the table isn't changed.
+ */
+bool htable_set_hash(htable_t *htable, htable_hash_t hash,
+                     htable_index_t index);
+
 /**
  * Find the key in the htable. If found, increase the count (data) of the kay.
  * If not found, create its item and set count (data) to 1.
  * Additionally, if the list at the index doesn't exist, allocate space for it.
+ * A new key is added to the end of the order of iteration, so iterators stay
+ * valid across calls to this function.
  * @param key The key string - it will be copied over to heap memory.
- * @return The found/created listitem of the key.
+ * @return The found/created listitem of the key or NULL if malloc failed.
  *
  */
 htable_listitem_t * htable_lookup(htable_t *htable, const char *key);
 
-/* Create a hash code for the key, to be used as an index in the table. */
+/**
+ * Same as htable_lookup(), but the key is given by its length and doesn't
+ * need to be terminated by '\0' (it's only copied if it's a new key).
+ */
+htable_listitem_t * htable_lookup_len(htable_t *htable, const char *key,
+                                      size_t len);
+
+/**
+ * Find the key without changing the table: unlike htable_lookup(), its count
+ * isn't increased, a missing key isn't added, no lists are moved while the
+ * table grows and no lookups are counted for htable_stats(). So any number of
+ * threads can call it at the same time, as long as no thread changes the
+ * table meanwhile; htable_lookup() is never safe to call that way.
+ * @return The item of the key, or NULL if it isn't in the table.
+ */
+htable_listitem_t * htable_find(const htable_t *htable, const char *key,
+                                size_t len);
+
+/**
+ * Same as calling htable_lookup_len() for every one of the 'n' keys in their
+ * order, but faster on tables larger than the CPU caches: the keys are
+ * hashed a few at a time and the memory of their lists (or slots) is
+ * prefetched before the first of them is looked up, so that the cache misses
+ * of the keys overlap instead of waiting for each other.
+ * @param results  Set to the item of every key.
+ * @return false if malloc failed or a key was longer than UINT_MAX, the
+ *      keys after that one aren't looked up and their results are NULL.
+ */
+bool htable_lookup_batch(htable_t *htable, const htable_str_t *keys,
+                         size_t n, htable_listitem_t **results);
+
+/**
+ * Add the counts (data) of all the keys of 'src' to 'dst'. The keys missing
+ * in 'dst' are inserted in the order in which 'src' is iterated. Merging
+ * tables that counted consecutive parts of an input, in their order, gives
+ * the same table (including the order of iteration) as counting the whole
+ * input at once.
+ * @return false if malloc failed, with only some of the keys merged.
+ */
+bool htable_merge(htable_t *dst, htable_t *src);
+
+/**
+ * Fill 'stats' with the number of keys, the distribution of list lengths (or
+ * probe distances) and the memory used by the table, and with the number of
+ * keys compared per htable_lookup() since the table was created. Goes
+ * through the whole table.
+ */
+void htable_stats(const htable_t *htable, htable_stats_t *stats);
+
+/* Create a hash code for the key, to be used as an index in a table with the
+ * default hash function. */
 unsigned int htable_hash_function(const char *str, unsigned int htable_size);
 
+/* The original hash function, `31*h + c` for every byte. It's slow on long
+ * keys and spreads similar keys (like hex numbers) badly. */
+uint64_t htable_hash_mult31(const char *key, size_t len);
+
+/* FNV-1a, byte at a time. */
+uint64_t htable_hash_fnv1a(const char *key, size_t len);
+
+/* wyhash, reads 4 to 48 bytes at a time, the fastest with the best spread. */
+uint64_t htable_hash_wyhash(const char *key, size_t len);
+
+/* Hash of the key, for HTABLE_DEFINE() maps with htable_str_eq(). */
+static inline uint64_t htable_str_hash(htable_str_t key) {
+    return htable_hash_wyhash(key.str, key.len);
+}
+
 
-/* Return the first item in the htable. */
+/* Return the first item in the htable. The items are iterated in the order
+ * in which their keys were inserted, with both backends. */
 htable_iterator_t htable_begin(htable_t *htable);
 
-/* Return the last item in the htable. */
+/* Return the last item in the htable, the one inserted last. */
 htable_iterator_t htable_end(htable_t *htable);
 
 /* Return the next item in the htable. */
@@ -0,0 +1,252 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+
+#include "htable.h"
+#include "htable_approx.h"
+
+/*
+ * The items are kept in three structures, all allocated once in
+ * htable_approx_init():
+ *
+ *  - the items themselves, one per tracked key;
+ *  - an open addressing index with linear probing, twice as large as the
+ *    number of items, to find the item of a key; since keys get replaced,
+ *    removing from it moves the following entries back instead of leaving
+ *    tombstones, so it never fills up;
+ *  - a binary min-heap of the items by count, to find the item that gets
+ *    replaced. A count only ever goes up, so an item only moves down.
+ */
+
+
+htable_approx_t * htable_approx_init(unsigned int capacity) {
+    if(capacity == 0 || capacity > UINT_MAX / 4)
+        return NULL;
+    htable_approx_t *htable = malloc(sizeof(htable_approx_t));
+    if(htable == NULL)
+        return NULL;
+
+    unsigned int slots = 1;
+    while(slots < 2 * capacity)
+        slots *= 2;
+    htable->capacity = capacity;
+    htable->used = 0;
+    htable->total = 0;
+    htable->items = calloc(capacity, sizeof(htable_approx_item_t));
+    htable->heap = malloc(capacity * sizeof(unsigned int));
+    htable->index = calloc(slots, sizeof(unsigned int));
+    htable->index_mask = slots - 1;
+    if(htable->items == NULL || htable->heap == NULL ||
+            htable->index == NULL) {
+        htable_approx_free(&htable);
+        return NULL;
+    }
+    return htable;
+}
+
+void htable_approx_free(htable_approx_t **htable) {
+    if((*htable)->items != NULL) {
+        for(unsigned int i = 0; i < (*htable)->used; i++)
+            free((*htable)->items[i].key);
+    }
+    free((*htable)->items);
+    free((*htable)->heap);
+    free((*htable)->index);
+    free(*htable);
+    *htable = NULL;
+}
+
+/* Slot of the index with the key, or the empty slot where it would be. */
+static unsigned int htable_approx_slot(htable_approx_t *htable,
+                                       const char *key, size_t len,
+                                       uint64_t hash) {
+    unsigned int slot = hash & htable->index_mask;
+    while(htable->index[slot] != 0) {
+        htable_approx_item_t *item = &htable->items[htable->index[slot] - 1];
+        if(item->hash == hash && item->len == len &&
+                memcmp(item->key, key, len) == 0)
+            break;
+        slot = (slot + 1) & htable->index_mask;
+    }
+    return slot;
+}
+
+/* Empty the slot, and move back the entries after it that would be
+ * unreachable otherwise. */
+static void htable_approx_unindex(htable_approx_t *htable, unsigned int slot) {
+    unsigned int mask = htable->index_mask;
+    unsigned int next = slot;
+    for(;;) {
+        next = (next + 1) & mask;
+        if(htable->index[next] == 0)
+            break;
+        unsigned int home =
+            htable->items[htable->index[next] - 1].hash & mask;
+        // can the entry at 'next' stay, or is 'slot' on its probe path?
+        if(((next - home) & mask) >= ((next - slot) & mask)) {
+            htable->index[slot] = htable->index[next];
+            slot = next;
+        }
+    }
+    htable->index[slot] = 0;
+}
+
+static void htable_approx_heap_set(htable_approx_t *htable, unsigned int pos,
+                                   unsigned int item) {
+    htable->heap[pos] = item;
+    htable->items[item].heap_index = pos;
+}
+
+/* Move the item at 'pos' down the heap after its count went up. */
+static void htable_approx_sift_down(htable_approx_t *htable,
+                                    unsigned int pos) {
+    unsigned int item = htable->heap[pos];
+    uint64_t count = htable->items[item].count;
+    for(;;) {
+        unsigned int child = 2 * pos + 1;
+        if(child >= htable->used)
+            break;
+        if(child + 1 < htable->used &&
+                htable->items[htable->heap[child + 1]].count <
+                htable->items[htable->heap[child]].count)
+            child++;
+        if(htable->items[htable->heap[child]].count >= count)
+            break;
+        htable_approx_heap_set(htable, pos, htable->heap[child]);
+        pos = child;
+    }
+    htable_approx_heap_set(htable, pos, item);
+}
+
+static bool htable_approx_set_key(htable_approx_item_t *item,
+                                  const char *key, size_t len) {
+    if(len + 1 > item->key_size) {
+        char *buffer = malloc(len + 1);
+        if(buffer == NULL)
+            return false;
+        free(item->key);
+        item->key = buffer;
+        item->key_size = len + 1;
+    }
+    memcpy(item->key, key, len);
+    item->key[len] = '\0';
+    item->len = len;
+    return true;
+}
+
+htable_approx_item_t * htable_approx_add(htable_approx_t *htable,
+                                         const char *key, size_t len) {
+    if(len >= UINT_MAX)
+        return NULL;
+    uint64_t hash = htable_hash_wyhash(key, len);
+    unsigned int slot = htable_approx_slot(htable, key, len, hash);
+    htable_approx_item_t *item;
+    htable->total++;
+
+    if(htable->index[slot] != 0) {
+        item = &htable->items[htable->index[slot] - 1];
+        item->count++;
+        htable_approx_sift_down(htable, item->heap_index);
+        return item;
+    }
+    if(htable->used < htable->capacity) {
+        // a free item, it goes to the top of the heap with its count of 1
+        unsigned int i = htable->used;
+        item = &htable->items[i];
+        if(!htable_approx_set_key(item, key, len)) {
+            htable->total--;
+            return NULL;
+        }
+        item->hash = hash;
+        item->count = 1;
+        item->error = 0;
+        htable->used++;
+        for(unsigned int pos = i; ; ) {
+            unsigned int parent = (pos - 1) / 2;
+            if(pos == 0 || htable->items[htable->heap[parent]].count <= 1) {
+                htable_approx_heap_set(htable, pos, i);
+                break;
+            }
+            htable_approx_heap_set(htable, pos, htable->heap[parent]);
+            pos = parent;
+        }
+        htable->index[slot] = i + 1;
+        return item;
+    }
+
+    // replace the key with the lowest count
+    unsigned int i = htable->heap[0];
+    item = &htable->items[i];
+    char *old_key = item->key;
+    unsigned int old_len = item->len;
+    uint64_t old_hash = item->hash;
+    unsigned int old_slot = htable_approx_slot(htable, old_key, old_len,
+                                               old_hash);
+    if(len + 1 > item->key_size) {
+        // keep the old key until it's removed from the index
+        char *buffer = malloc(len + 1);
+        if(buffer == NULL) {
+            htable->total--;
+            return NULL;
+        }
+        htable_approx_unindex(htable, old_slot);
+        free(old_key);
+        item->key = buffer;
+        item->key_size = len + 1;
+    }
+    else {
+        htable_approx_unindex(htable, old_slot);
+    }
+    htable_approx_set_key(item, key, len);
+    item->hash = hash;
+    item->error = item->count;
+    item->count++;
+    htable_approx_sift_down(htable, 0);
+    // the removal could have moved the empty slot for the new key
+    htable->index[htable_approx_slot(htable, key, len, hash)] = i + 1;
+    return item;
+}
+
+static int htable_approx_compare(const void *a, const void *b) {
+    const htable_approx_item_t *x = *(htable_approx_item_t * const *)a;
+    const htable_approx_item_t *y = *(htable_approx_item_t * const *)b;
+    if(x->count != y->count)
+        return (x->count > y->count) ? -1 : 1;
+    unsigned int len = (x->len < y->len) ? x->len : y->len;
+    int cmp = memcmp(x->key, y->key, len);
+    if(cmp != 0) return cmp;
+    if(x->len != y->len) return (x->len < y->len) ? -1 : 1;
+    return 0;
+}
+
+htable_approx_item_t ** htable_approx_sorted(htable_approx_t *htable,
+                                             size_t *n) {
+    // malloc(0) could return NULL
+    htable_approx_item_t **items =
+        malloc((htable->used + 1) * sizeof(htable_approx_item_t *));
+    if(items == NULL)
+        return NULL;
+    for(unsigned int i = 0; i < htable->used; i++)
+        items[i] = &htable->items[i];
+    qsort(items, htable->used, sizeof(htable_approx_item_t *),
+          htable_approx_compare);
+    *n = htable->used;
+    return items;
+}
@@ -0,0 +1,86 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Approximate counting of the most common keys in a fixed amount of memory
+ * (the Space-Saving algorithm), for streams with too many different keys to
+ * keep all of them in a htable_t.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __HTABLE_APPROX_H__
+#define __HTABLE_APPROX_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct htable_approx            htable_approx_t;
+typedef struct htable_approx_item       htable_approx_item_t;
+
+
+struct htable_approx {
+    unsigned int capacity;       // how many keys are tracked at most
+    unsigned int used;
+    uint64_t total;              // number of added keys
+    htable_approx_item_t *items;
+    unsigned int *heap;          // item indexes, the lowest count first
+    unsigned int *index;         // open addressing, item index + 1 or 0
+    unsigned int index_mask;
+};
+
+/* The real number of occurrences of the key is between count - error and
+ * count. */
+struct htable_approx_item {
+    char *key;
+    unsigned int len;
+    unsigned int key_size;       // allocated size of key
+    uint64_t count;
+    uint64_t error;
+    uint64_t hash;
+    unsigned int heap_index;     // position of the item in the heap
+};
+
+
+/**
+ * Allocate a table that tracks at most 'capacity' keys. The memory doesn't
+ * grow with the number of different added keys, only the buffers of the
+ * tracked keys grow when a longer key replaces a shorter one.
+ * @return  Pointer to the created table or NULL if malloc failed.
+ */
+htable_approx_t * htable_approx_init(unsigned int capacity);
+
+/* Free space after table and all its contents. */
+void htable_approx_free(htable_approx_t **htable);
+
+/**
+ * Count one occurrence of the key. When the table is full and the key isn't
+ * tracked, it replaces the key with the lowest count, and takes over that
+ * count (plus one) as its own, with the old count as its error. So every key
+ * that occurred more than total / capacity times is guaranteed to be in the
+ * table, and no count is ever lower than the real number of occurrences.
+ * @return  The item of the key or NULL if malloc failed.
+ */
+htable_approx_item_t * htable_approx_add(htable_approx_t *htable,
+                                         const char *key, size_t len);
+
+/**
+ * All the tracked keys, the highest count first, the same counts by key.
+ * @param n  Set to the number of returned items.
+ * @return  Array of pointers into the table, which has to be freed, or NULL
+ *          if malloc failed.
+ */
+htable_approx_item_t ** htable_approx_sorted(htable_approx_t *htable,
+                                             size_t *n);
+
+#endif /* __HTABLE_APPROX_H__ */
@@ -0,0 +1,145 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "htable.h"
+#include "htable_concurrent.h"
+
+/*
+ * Like the HTABLE_CHAINED table, this one is an array of linked lists, but
+ * without any locks:
+ *
+ *  - Items are never removed and their keys never change, so a thread can
+ *    walk a list while others are adding to it. New items are added to the
+ *    head of the list with compare-and-swap (so that the list is always
+ *    consistent); if another thread added an item in the meantime, only the
+ *    items between the new and the old head need to be searched again, since
+ *    the key could have been just added by the other thread.
+ *  - The counts are updated with atomic adds.
+ *
+ * The GCC __atomic builtins are used, since C99 doesn't have atomics. The
+ * table doesn't grow, since moving items between lists while other threads
+ * walk them would need locks or much more complicated bookkeeping.
+ */
+
+
+htable_concurrent_t * htable_concurrent_init(unsigned int size) {
+    htable_concurrent_t *htable = malloc(sizeof(htable_concurrent_t));
+    if(htable == NULL)
+        return NULL;
+
+    unsigned int lists = 1;
+    while(lists < size && lists <= UINT_MAX / 2)
+        lists *= 2;
+    htable->list = calloc(lists, sizeof(htable_concurrent_item_t *));
+    if(htable->list == NULL) {
+        free(htable);
+        return NULL;
+    }
+    htable->size = lists;
+    return htable;
+}
+
+void htable_concurrent_free(htable_concurrent_t **htable) {
+    for(unsigned int i = 0; i < (*htable)->size; i++) {
+        while((*htable)->list[i] != NULL) {
+            htable_concurrent_item_t *tmp = (*htable)->list[i];
+            (*htable)->list[i] = tmp->next;
+            free(tmp);
+        }
+    }
+    free((*htable)->list);
+    free(*htable);
+    *htable = NULL;
+}
+
+/* Search the items from 'item' up to (not including) 'stop'. */
+static htable_concurrent_item_t * htable_concurrent_find(
+        htable_concurrent_item_t *item, htable_concurrent_item_t *stop,
+        const char *key, size_t len) {
+    for( ; item != stop; item = item->next) {
+        if(item->len == len && memcmp(item->key, key, len) == 0)
+            return item;
+    }
+    return NULL;
+}
+
+htable_concurrent_item_t * htable_concurrent_add(htable_concurrent_t *htable,
+                                                 const char *key, size_t len,
+                                                 uint64_t count) {
+    if(len > UINT_MAX) {
+        errno = EOVERFLOW;
+        return NULL;
+    }
+    unsigned int i = htable_hash_wyhash(key, len) & (htable->size - 1);
+    htable_concurrent_item_t *head = __atomic_load_n(&htable->list[i],
+                                                     __ATOMIC_ACQUIRE);
+    htable_concurrent_item_t *stop = NULL;
+    htable_concurrent_item_t *item = NULL;
+
+    for(;;) {
+        htable_concurrent_item_t *found = htable_concurrent_find(head, stop,
+                                                                 key, len);
+        if(found != NULL) {
+            free(item);  // another thread added the key first
+            __atomic_fetch_add(&found->data, count, __ATOMIC_RELAXED);
+            return found;
+        }
+
+        if(item == NULL) {
+            item = malloc(sizeof(htable_concurrent_item_t) + len + 1);
+            if(item == NULL)
+                return NULL;
+            memcpy(item->key, key, len);
+            item->key[len] = '\0';
+            item->len = len;
+            item->data = count;
+        }
+        item->next = head;
+        stop = head;
+        // on failure, 'head' is updated to the current head of the list
+        if(__atomic_compare_exchange_n(&htable->list[i], &head, item, false,
+                                       __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+            return item;
+    }
+}
+
+htable_concurrent_item_t * htable_concurrent_lookup(htable_concurrent_t *htable,
+                                                    const char *key) {
+    return htable_concurrent_add(htable, key, strlen(key), 1);
+}
+
+htable_concurrent_item_t * htable_concurrent_lookup_len(
+        htable_concurrent_t *htable, const char *key, size_t len) {
+    return htable_concurrent_add(htable, key, len, 1);
+}
+
+void htable_concurrent_foreach(htable_concurrent_t *htable,
+                               void (*function)(htable_concurrent_item_t *item,
+                                                void *arg),
+                               void *arg) {
+    for(unsigned int i = 0; i < htable->size; i++) {
+        for(htable_concurrent_item_t *item = htable->list[i]; item != NULL;
+                item = item->next) {
+            function(item, arg);
+        }
+    }
+}
@@ -0,0 +1,94 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Hash table where the keys are strings and values are counters, which can be
+ * used by many threads at the same time.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __HTABLE_CONCURRENT_H__
+#define __HTABLE_CONCURRENT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct htable_concurrent            htable_concurrent_t;
+typedef struct htable_concurrent_item       htable_concurrent_item_t;
+
+
+struct htable_concurrent {
+    unsigned int size;  // a power of two
+    htable_concurrent_item_t **list;
+};
+
+struct htable_concurrent_item {
+    htable_concurrent_item_t *next;
+    uint64_t data;          // the count, 64 bits like in htable_t
+    unsigned int len;       // length of the key, without '\0'
+    char key[];             // ends with '\0', but can contain it too
+};
+
+
+/**
+ * Allocate space for the hash table. Unlike htable_t, this table doesn't
+ * grow, so 'size' has to be about the expected number of keys. The table
+ * never gets full: adding keys only fails if malloc fails, but with more keys
+ * than lists, the lists get longer and every lookup walks its list, so it
+ * slows down in proportion to keys / size (on a million keys, about 200 ns
+ * per hit with a list per key, 1.2 us with 16 keys per list and 4.4 us with
+ * 64). A table that is too large only costs a pointer per list.
+ * @param size  Number of lists, rounded up to a power of two.
+ * @return  Pointer to the created table or NULL if malloc failed.
+ */
+htable_concurrent_t * htable_concurrent_init(unsigned int size);
+
+/* Free space after table and all its contents. Not thread safe. */
+void htable_concurrent_free(htable_concurrent_t **htable);
+
+/**
+ * Find the key of length 'len' in the htable and add 'count' to its data. If not found,
+ * create its item with data set to 'count'. Can be called from any number of
+ * threads at the same time, without locking.
+ *
+ * Every call updates the data of the item with an atomic add, so when many
+ * threads count the same few keys, they all compete for the same cache lines.
+ * Counting the most common keys locally first and adding the sums scales
+ * better than calling this with 'count' 1 for every occurrence.
+ * @param key  Doesn't need to be terminated by '\0', keys are compared by
+ *             their length and bytes, like in htable_t.
+ * @return The found/created item of the key or NULL if malloc failed.
+ */
+htable_concurrent_item_t * htable_concurrent_add(htable_concurrent_t *htable,
+                                                 const char *key, size_t len,
+                                                 uint64_t count);
+
+/* Same as htable_concurrent_add() with 'count' 1 and a '\0' terminated key. */
+htable_concurrent_item_t * htable_concurrent_lookup(htable_concurrent_t *htable,
+                                                    const char *key);
+
+/* Same as htable_concurrent_add() with 'count' 1. */
+htable_concurrent_item_t * htable_concurrent_lookup_len(
+        htable_concurrent_t *htable, const char *key, size_t len);
+
+/**
+ * Call 'function' for every item of the table. Not thread safe, all the
+ * threads adding keys need to be finished.
+ */
+void htable_concurrent_foreach(htable_concurrent_t *htable,
+                               void (*function)(htable_concurrent_item_t *item,
+                                                void *arg),
+                               void *arg);
+
+#endif /* __HTABLE_CONCURRENT_H__ */
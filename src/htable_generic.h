@@ -0,0 +1,223 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Hash tables specialized at compile time for their key and value types.
+ * Their hash and equality functions are called directly, so the compiler can
+ * inline them. HTABLE_DEFINE() is a complete map of any keys and values, the
+ * lists of htable_t are generated by HTABLE_DEFINE_CHAINED().
+ *
+ *   HTABLE_DEFINE(name, K, V, hash, eq)
+ *
+ * defines the types name_t and name_entry_t and static functions for them:
+ *
+ *   bool name_init(name_t *map, size_t capacity);
+ *   void name_free(name_t *map);
+ *   name_entry_t * name_find(const name_t *map, K key);
+ *   name_entry_t * name_insert(name_t *map, K key, bool *inserted);
+ *   name_entry_t * name_next(const name_t *map, const name_entry_t *entry);
+ *
+ * 'hash' is called as hash(key) and returns uint64_t, 'eq' as eq(a, b) and
+ * returns whether the keys are equal; both can be functions or macros.
+ * name_insert() returns the entry of the key, after adding it with a value
+ * of all zero bits if it wasn't there, and sets '*inserted'. The map stores
+ * the key as it is given, so a key pointing to memory that doesn't outlive
+ * the call has to be replaced by a copy in the new entry. name_next() goes
+ * over all the entries, starting with NULL, and returns NULL after the last
+ * one. The pointers to entries stay valid only until the next insert.
+ *
+ * For example, strings counted with 64-bit counts, like in htable_t:
+ *
+ *   HTABLE_DEFINE(word_counts, htable_str_t, uint64_t, htable_str_hash,
+ *                 htable_str_eq)
+ *
+ * The lists of a chained table, whose items are allocated (and hashed) by the
+ * caller:
+ *
+ *   HTABLE_DEFINE_CHAINED(name, T, K, eq)
+ *
+ * defines the type name_list_t, a list of items of type T linked by their
+ * 'next' member, and static functions for it:
+ *
+ *   T * name_list_find(const name_list_t *list, K key, unsigned long *probes);
+ *   void name_list_append(name_list_t *list, T *item);
+ *   T * name_list_pop(name_list_t *list);
+ *
+ * 'eq' is called as eq(item, key). name_list_find() returns the item with the
+ * key or NULL, and adds the number of compared items to '*probes'. The items
+ * stay in the order in which they were appended; name_list_pop() removes the
+ * first one, or returns NULL when the list is empty. htable_t instantiates it
+ * for its items and htable_str_t keys in htable.h.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __HTABLE_GENERIC_H__
+#define __HTABLE_GENERIC_H__
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* The map grows when more than 3/4 of the slots are used. */
+#define HTABLE_GENERIC_MIN_SIZE 16
+
+/*
+ * Open addressing with linear probing. Every entry keeps the hash of its key,
+ * which makes most comparisons of different keys cheap and growing the map
+ * possible without hashing again; a hash of 0 marks an empty entry, so the
+ * real hashes of 0 are changed to 1.
+ */
+#define HTABLE_DEFINE(name, K, V, hash, eq) \
+\
+typedef struct name##_entry { \
+    uint64_t hash; \
+    K key; \
+    V value; \
+} name##_entry_t; \
+\
+typedef struct name { \
+    size_t size;              /* a power of two */ \
+    size_t count; \
+    name##_entry_t *entries; \
+} name##_t; \
+\
+static inline bool name##_init(name##_t *map, size_t capacity) { \
+    size_t size = HTABLE_GENERIC_MIN_SIZE; \
+    while(size / 4 * 3 < capacity && size <= SIZE_MAX / 4) \
+        size *= 2; \
+    map->entries = calloc(size, sizeof(name##_entry_t)); \
+    map->size = size; \
+    map->count = 0; \
+    return map->entries != NULL; \
+} \
+\
+static inline void name##_free(name##_t *map) { \
+    free(map->entries); \
+    map->entries = NULL; \
+    map->size = 0; \
+    map->count = 0; \
+} \
+\
+static inline uint64_t name##_hash(K key) { \
+    uint64_t h = hash(key); \
+    return h ? h : 1; \
+} \
+\
+static inline name##_entry_t * name##_find(const name##_t *map, K key) { \
+    uint64_t h = name##_hash(key); \
+    size_t mask = map->size - 1; \
+    for(size_t i = h & mask; map->entries[i].hash != 0; i = (i + 1) & mask) { \
+        if(map->entries[i].hash == h && eq(map->entries[i].key, key)) \
+            return &map->entries[i]; \
+    } \
+    return NULL; \
+} \
+\
+static inline bool name##_grow(name##_t *map) { \
+    if(map->size > SIZE_MAX / 2 / sizeof(name##_entry_t)) \
+        return false; \
+    size_t size = map->size * 2, mask = size - 1; \
+    name##_entry_t *entries = calloc(size, sizeof(name##_entry_t)); \
+    if(entries == NULL) \
+        return false; \
+    for(size_t j = 0; j < map->size; j++) { \
+        if(map->entries[j].hash == 0) \
+            continue; \
+        size_t i = map->entries[j].hash & mask; \
+        while(entries[i].hash != 0) \
+            i = (i + 1) & mask; \
+        entries[i] = map->entries[j]; \
+    } \
+    free(map->entries); \
+    map->entries = entries; \
+    map->size = size; \
+    return true; \
+} \
+\
+static inline name##_entry_t * name##_insert(name##_t *map, K key, \
+                                             bool *inserted) { \
+    uint64_t h = name##_hash(key); \
+    size_t mask = map->size - 1; \
+    size_t i = h & mask; \
+    for(; map->entries[i].hash != 0; i = (i + 1) & mask) { \
+        if(map->entries[i].hash == h && eq(map->entries[i].key, key)) { \
+            *inserted = false; \
+            return &map->entries[i]; \
+        } \
+    } \
+    if(map->count + 1 > map->size / 4 * 3) { \
+        if(!name##_grow(map)) \
+            return NULL; \
+        mask = map->size - 1; \
+        for(i = h & mask; map->entries[i].hash != 0; i = (i + 1) & mask) {} \
+    } \
+    memset(&map->entries[i], 0, sizeof(name##_entry_t)); \
+    map->entries[i].hash = h; \
+    map->entries[i].key = key; \
+    map->count++; \
+    *inserted = true; \
+    return &map->entries[i]; \
+} \
+\
+static inline name##_entry_t * name##_next(const name##_t *map, \
+                                           const name##_entry_t *entry) { \
+    size_t i = (entry == NULL) ? 0 : (size_t)(entry - map->entries) + 1; \
+    for(; i < map->size; i++) { \
+        if(map->entries[i].hash != 0) \
+            return &map->entries[i]; \
+    } \
+    return NULL; \
+}
+
+/* A list set to all zero bits is empty, so an array of them can be allocated
+ * with calloc(). */
+#define HTABLE_DEFINE_CHAINED(name, T, K, eq) \
+\
+typedef struct name##_list { \
+    T *head; \
+    T *tail; \
+} name##_list_t; \
+\
+static inline T * name##_list_find(const name##_list_t *list, K key, \
+                                   unsigned long *probes) { \
+    for(T *item = list->head; item != NULL; item = item->next) { \
+        (*probes)++; \
+        if(eq(item, key)) \
+            return item; \
+    } \
+    return NULL; \
+} \
+\
+static inline void name##_list_append(name##_list_t *list, T *item) { \
+    item->next = NULL; \
+    if(list->tail != NULL) \
+        list->tail->next = item; \
+    else \
+        list->head = item; \
+    list->tail = item; \
+} \
+\
+static inline T * name##_list_pop(name##_list_t *list) { \
+    T *item = list->head; \
+    if(item != NULL) { \
+        list->head = item->next; \
+        if(list->head == NULL) \
+            list->tail = NULL; \
+    } \
+    return item; \
+}
+
+#endif /* __HTABLE_GENERIC_H__ */
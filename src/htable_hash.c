@@ -0,0 +1,138 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Hash functions for the keys of the hash table.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "htable.h"
+
+
+uint64_t htable_hash_mult31(const char *key, size_t len) {
+    uint64_t h = 0;
+    const unsigned char *p = (const unsigned char *)key;
+
+    for(size_t i = 0; i < len; i++)
+        h = 31*h + p[i];
+    return h;
+}
+
+uint64_t htable_hash_fnv1a(const char *key, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const unsigned char *p = (const unsigned char *)key;
+
+    for(size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/*
+ * wyhash (final version 4) by Wang Yi, released into the public domain. It
+ * reads the key 4, 8 or 48 bytes at a time and mixes them by multiplying
+ * 64-bit words into a 128-bit result.
+ */
+__extension__ typedef unsigned __int128 htable_uint128_t;
+
+static const uint64_t wyhash_secret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+    0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+static void wyhash_mum(uint64_t *a, uint64_t *b) {
+    htable_uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+}
+
+static uint64_t wyhash_mix(uint64_t a, uint64_t b) {
+    wyhash_mum(&a, &b);
+    return a ^ b;
+}
+
+static uint64_t wyhash_read8(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint64_t wyhash_read4(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint64_t wyhash_read3(const unsigned char *p, size_t k) {
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+uint64_t htable_hash_wyhash(const char *key, size_t len) {
+    const unsigned char *p = (const unsigned char *)key;
+    const uint64_t *secret = wyhash_secret;
+    uint64_t seed = wyhash_mix(secret[0], secret[1]);
+    uint64_t a, b;
+
+    if(len <= 16) {
+        if(len >= 4) {
+            a = (wyhash_read4(p) << 32) | wyhash_read4(p + ((len >> 3) << 2));
+            b = (wyhash_read4(p + len - 4) << 32) |
+                wyhash_read4(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if(len > 0) {
+            a = wyhash_read3(p, len);
+            b = 0;
+        }
+        else {
+            a = b = 0;
+        }
+    }
+    else {
+        size_t i = len;
+        if(i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = wyhash_mix(wyhash_read8(p) ^ secret[1],
+                                  wyhash_read8(p + 8) ^ seed);
+                see1 = wyhash_mix(wyhash_read8(p + 16) ^ secret[2],
+                                  wyhash_read8(p + 24) ^ see1);
+                see2 = wyhash_mix(wyhash_read8(p + 32) ^ secret[3],
+                                  wyhash_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while(i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while(i > 16) {
+            seed = wyhash_mix(wyhash_read8(p) ^ secret[1],
+                              wyhash_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = wyhash_read8(p + i - 16);
+        b = wyhash_read8(p + i - 8);
+    }
+    a ^= secret[1];
+    b ^= seed;
+    wyhash_mum(&a, &b);
+    return wyhash_mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+unsigned int htable_hash_function(const char *key, unsigned int htable_size) {
+    return htable_hash_wyhash(key, strlen(key)) % htable_size;
+}
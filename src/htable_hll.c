@@ -0,0 +1,172 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "htable.h"
+#include "htable_hll.h"
+
+/*
+ * The top 'precision' bits of the 64-bit hash of a key select a register, and
+ * the register keeps the highest position of the first set bit in the rest of
+ * the hash it has seen. With n different keys, about n / 2^k of them have
+ * their first set bit at position k, so the registers tell the magnitude of
+ * n, and averaging them over all the registers makes it precise.
+ *
+ * Since a register only ever takes the maximum, adding the same key twice
+ * changes nothing and merging two sketches is the maximum of each register.
+ */
+
+// "HLL" and the version of the format, followed by the precision
+static const char htable_hll_magic[4] = {'H', 'L', 'L', '1'};
+
+
+htable_hll_t * htable_hll_init(unsigned int precision) {
+    if(precision < HTABLE_HLL_MIN_PRECISION ||
+            precision > HTABLE_HLL_MAX_PRECISION)
+        return NULL;
+    htable_hll_t *hll = malloc(sizeof(htable_hll_t));
+    if(hll == NULL)
+        return NULL;
+    hll->precision = precision;
+    hll->size = (size_t)1 << precision;
+    hll->registers = calloc(hll->size, 1);
+    if(hll->registers == NULL) {
+        free(hll);
+        return NULL;
+    }
+    return hll;
+}
+
+void htable_hll_free(htable_hll_t **hll) {
+    free((*hll)->registers);
+    free(*hll);
+    *hll = NULL;
+}
+
+void htable_hll_add(htable_hll_t *hll, const char *key, size_t len) {
+    uint64_t hash = htable_hash_wyhash(key, len);
+    size_t index = hash >> (64 - hll->precision);
+    // the marker bit limits the rank to 64 - precision + 1
+    uint64_t rest = (hash << hll->precision) |
+                    ((uint64_t)1 << (hll->precision - 1));
+    uint8_t rank = __builtin_clzll(rest) + 1;
+    if(rank > hll->registers[index])
+        hll->registers[index] = rank;
+}
+
+bool htable_hll_merge(htable_hll_t *dst, const htable_hll_t *src) {
+    if(dst->precision != src->precision)
+        return false;
+    for(size_t i = 0; i < dst->size; i++) {
+        if(src->registers[i] > dst->registers[i])
+            dst->registers[i] = src->registers[i];
+    }
+    return true;
+}
+
+/* Corrections of the estimate for the registers that are still zero (sigma)
+ * and those that reached the highest rank (tau), see below. */
+static double htable_hll_sigma(double x) {
+    if(x == 1.0)
+        return INFINITY;
+    double y = 1.0, z = x, previous;
+    do {
+        x *= x;
+        previous = z;
+        z += x * y;
+        y += y;
+    } while(z != previous);
+    return z;
+}
+
+static double htable_hll_tau(double x) {
+    if(x == 0.0 || x == 1.0)
+        return 0.0;
+    double y = 1.0, z = 1.0 - x, previous;
+    do {
+        x = sqrt(x);
+        previous = z;
+        y *= 0.5;
+        z -= (1.0 - x) * (1.0 - x) * y;
+    } while(z != previous);
+    return z / 3.0;
+}
+
+/*
+ * The improved estimator by Otmar Ertl ("New cardinality estimation
+ * algorithms for HyperLogLog sketches", 2017). Unlike the original one, it
+ * needs neither linear counting for small numbers of keys nor a table of
+ * empirical bias corrections, and it's as precise over the whole range.
+ */
+double htable_hll_estimate(const htable_hll_t *hll) {
+    unsigned int q = 64 - hll->precision;
+    double m = hll->size;
+    // how many registers have each value, 0 to q + 1
+    size_t histogram[64 + 2] = {0};
+    for(size_t i = 0; i < hll->size; i++)
+        histogram[hll->registers[i]]++;
+    if(histogram[0] == hll->size)
+        return 0.0;
+
+    double z = m * htable_hll_tau(1.0 - histogram[q + 1] / m);
+    for(unsigned int k = q; k >= 1; k--)
+        z = 0.5 * (z + histogram[k]);
+    z += m * htable_hll_sigma(histogram[0] / m);
+    return m * m / (2.0 * log(2.0)) / z;
+}
+
+bool htable_hll_save(const htable_hll_t *hll, FILE *file) {
+    uint8_t precision = hll->precision;
+    return fwrite(htable_hll_magic, sizeof(htable_hll_magic), 1, file) == 1 &&
+           fwrite(&precision, 1, 1, file) == 1 &&
+           fwrite(hll->registers, 1, hll->size, file) == hll->size;
+}
+
+htable_hll_t * htable_hll_load(FILE *file) {
+    char magic[sizeof(htable_hll_magic)];
+    uint8_t precision;
+    htable_hll_t *hll = NULL;
+    errno = 0;
+    if(fread(magic, sizeof(magic), 1, file) != 1 ||
+            memcmp(magic, htable_hll_magic, sizeof(magic)) != 0 ||
+            fread(&precision, 1, 1, file) != 1)
+        goto invalid;
+    hll = htable_hll_init(precision);
+    if(hll == NULL) {
+        if(precision < HTABLE_HLL_MIN_PRECISION ||
+                precision > HTABLE_HLL_MAX_PRECISION)
+            goto invalid;
+        return NULL;
+    }
+    if(fread(hll->registers, 1, hll->size, file) != hll->size ||
+            fgetc(file) != EOF)
+        goto invalid;
+    for(size_t i = 0; i < hll->size; i++) {
+        if(hll->registers[i] > 64 - precision + 1)
+            goto invalid;
+    }
+    return hll;
+invalid:
+    if(hll) htable_hll_free(&hll);
+    // keep the error of a failed read
+    if(errno == 0 || !ferror(file))
+        errno = EINVAL;
+    return NULL;
+}
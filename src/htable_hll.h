@@ -0,0 +1,85 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Estimating the number of different keys in a fixed amount of memory with a
+ * HyperLogLog sketch, for when even the keys themselves don't fit in memory.
+ * Sketches of separate inputs can be saved and merged into the sketch of all
+ * of them.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __HTABLE_HLL_H__
+#define __HTABLE_HLL_H__
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The sketch has 2^precision registers of one byte each and the relative
+ * standard error of the estimate is about 1.04 / sqrt(2^precision). */
+#define HTABLE_HLL_MIN_PRECISION 4
+#define HTABLE_HLL_MAX_PRECISION 18
+// 4 KiB, about 1.6 % error
+#define HTABLE_HLL_PRECISION 12
+
+
+typedef struct htable_hll               htable_hll_t;
+
+struct htable_hll {
+    unsigned int precision;
+    size_t size;                 // 2^precision
+    uint8_t *registers;
+};
+
+
+/**
+ * Allocate an empty sketch with 2^precision registers.
+ * @return  Pointer to the created sketch or NULL if malloc failed or the
+ *          precision is out of range.
+ */
+htable_hll_t * htable_hll_init(unsigned int precision);
+
+/* Free space after the sketch. */
+void htable_hll_free(htable_hll_t **hll);
+
+/* Add the key, hashed with htable_hash_wyhash(). */
+void htable_hll_add(htable_hll_t *hll, const char *key, size_t len);
+
+/**
+ * Add all the keys of 'src' into 'dst', as if they were added to it
+ * directly. The sketches need the same precision.
+ * @return  False if the precisions differ.
+ */
+bool htable_hll_merge(htable_hll_t *dst, const htable_hll_t *src);
+
+/* Estimated number of different added keys. */
+double htable_hll_estimate(const htable_hll_t *hll);
+
+/**
+ * Write the sketch to the file, to be loaded by htable_hll_load(). The format
+ * doesn't depend on the machine, but it's only valid as long as the keys are
+ * hashed the same way.
+ * @return  False if writing failed.
+ */
+bool htable_hll_save(const htable_hll_t *hll, FILE *file);
+
+/**
+ * Read a sketch written by htable_hll_save().
+ * @return  The sketch or NULL if the file isn't a valid sketch (errno is set
+ *          to EINVAL), or if reading or malloc failed.
+ */
+htable_hll_t * htable_hll_load(FILE *file);
+
+#endif /* __HTABLE_HLL_H__ */
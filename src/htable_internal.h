@@ -0,0 +1,78 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Functions shared by the modules of the hash table, not a part of its
+ * interface.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __HTABLE_INTERNAL_H__
+#define __HTABLE_INTERNAL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "htable.h"
+
+// Number of items in one page of htable->pages, a power of two.
+#define HTABLE_PAGE 1024
+
+/* The item inserted as the 'index'-th one (counting from 0). */
+static inline htable_listitem_t * htable_item_at(const htable_t *htable,
+                                                 unsigned long index) {
+    return &htable->pages[index / HTABLE_PAGE][index % HTABLE_PAGE];
+}
+
+/* Hash of the whole key with the hash function of the table. */
+uint64_t htable_hash(const htable_t *htable, const char *key, size_t len);
+
+/* Index of the list for the given hash, in an array of 'size' lists. */
+unsigned int htable_index(const htable_t *htable, uint64_t hash,
+                          unsigned int size);
+
+/* Allocate a new item for the key, with its count set to 1. It's the next
+ * item in the order of insertion, so the caller has to add it to the table
+ * (and increase htable->count) before the next call. */
+htable_listitem_t * htable_new_item(htable_t *htable, const char *key,
+                                    size_t len);
+
+/* Count one lookup that compared 'probes' keys or groups. */
+#ifdef HTABLE_STATS
+#define HTABLE_COUNT_PROBES(htable, n) do { \
+        (htable)->lookups++; \
+        (htable)->probes += (n); \
+        if((n) > (htable)->max_probes) (htable)->max_probes = (n); \
+    } while(0)
+#else
+#define HTABLE_COUNT_PROBES(htable, n) do {} while(0)
+#endif
+
+/* Allocate the control bytes and slots of a HTABLE_SWISS table. */
+bool htable_swiss_init(htable_t *htable, unsigned int size);
+
+/* Prefetch the first group of slots where a key with the hash would be. */
+void htable_swiss_prefetch(const htable_t *htable, uint64_t key_hash);
+
+/* htable_lookup() for HTABLE_SWISS tables. */
+htable_listitem_t * htable_swiss_lookup(htable_t *htable, const char *key,
+                                        size_t len, uint64_t hash);
+
+/* htable_find() for HTABLE_SWISS tables. */
+htable_listitem_t * htable_swiss_find(const htable_t *htable, const char *key,
+                                      size_t len, uint64_t hash);
+
+/* The lengths histogram and memory of the slots, for htable_stats(). */
+void htable_swiss_stats(const htable_t *htable, htable_stats_t *stats);
+
+#endif /* __HTABLE_INTERNAL_H__ */
@@ -20,69 +20,49 @@
 #include <stdbool.h>
 
 #include "htable.h"
+#include "htable_internal.h"
 
 
-htable_iterator_t htable_begin(htable_t * htable) {
+/*
+ * The items are kept in the order of insertion in pages (see htable.c), so
+ * the iterator doesn't look at the lists or the slots at all, it only counts
+ * the items. Their order depends only on the keys and the order in which they
+ * were inserted, not on the backend or the size of the table, and it doesn't
+ * change while the table grows.
+ */
+
+/* Iterator pointing to the 'index'-th item, or the end. */
+static htable_iterator_t htable_item_iterator(htable_t *htable,
+                                              unsigned long index) {
     htable_iterator_t iterator = {
         .htable = htable,
         .index  = 0,
         .ptr    = NULL,
     };
-
-    // cycle trough the htable until we find a non-empty list.
-    for(unsigned int i = 0; i < htable->size; i++) {
-        if(htable->list[i].head != NULL) {
-            iterator.index = i;
-            iterator.ptr = htable->list[i].head;
-            break;
-        }
+    if(index < htable->count) {
+        iterator.index = index;
+        iterator.ptr = htable_item_at(htable, index);
     }
     return iterator;
 }
 
-htable_iterator_t htable_end(htable_t * htable) {
-    htable_iterator_t iterator = {
-        .htable = htable,
-        .index  = 0,
-        .ptr    = NULL,
-    };
+htable_iterator_t htable_begin(htable_t * htable) {
+    return htable_item_iterator(htable, 0);
+}
 
-    // cycle trough the htable from the end until we find an non-empty list.
-    for(int i = htable->size - 1; i >= 0 ; i--) {
-        if(htable->list[i].tail != NULL) {
-            iterator.index = i;
-            iterator.ptr = htable->list[i].tail;
-            break;
-        }
-    }
-    return iterator;
+htable_iterator_t htable_end(htable_t * htable) {
+    return htable_item_iterator(htable, htable->count - 1);
 }
 
 htable_iterator_t htable_it_next(htable_iterator_t iterator) {
-    htable_iterator_t result = {
-        .htable = iterator.htable,
-        .index  = 0,
-        .ptr    = NULL
-    };
-
-    if(iterator.ptr->next != NULL) {
-        // return the next item in the same list if it's not empty
-        result.index = iterator.index;
-        result.ptr = iterator.ptr->next;
-    }
-    else {
-        // find the next list that's not empty end return a pointer to its
-        // first item
-        unsigned int i;
-        for(i = iterator.index + 1; i < iterator.htable->size; i++) {
-            if(iterator.htable->list[i].head != NULL) {
-                result.index = i;
-                result.ptr = iterator.htable->list[i].head;
-                break;
-            }
-        }
+    unsigned long index = iterator.index + 1;
+    // the next item is in the same page, unless this one is the last of it
+    if(index % HTABLE_PAGE != 0 && index < iterator.htable->count) {
+        iterator.index = index;
+        iterator.ptr++;
+        return iterator;
     }
-    return result;
+    return htable_item_iterator(iterator.htable, index);
 }
 
 bool htable_it_eq(htable_iterator_t iterator1, htable_iterator_t iterator2) {
@@ -0,0 +1,236 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "htable.h"
+#include "htable_mapped.h"
+
+/*
+ * The file consists of:
+ *
+ *  - the header below;
+ *  - the buckets, a power of two of them, at least twice the number of keys,
+ *    each with the index of an item plus one, or 0 if it's empty; a key is
+ *    in the first non-empty bucket from (hash & mask) on that has it;
+ *  - the items, in the order of iteration of the saved table;
+ *  - the keys, one after another, each ending with '\0'.
+ *
+ * The numbers are in the byte order of the machine that wrote the file, which
+ * the magic number checks. Everything is aligned to 8 bytes, so the file can
+ * be used in place.
+ */
+#define HTABLE_MAPPED_MAGIC 0x3270616d62617468ULL   // "htabmap2"
+
+typedef struct htable_mapped_header {
+    uint64_t magic;
+    uint32_t hash;               // index in htable_mapped_hashes
+    uint32_t unused;
+    uint64_t count;
+    uint64_t buckets;
+    uint64_t keys_size;
+    uint64_t user[HTABLE_MAPPED_USER];
+} htable_mapped_header_t;
+
+// the hash functions a snapshot can use, their index is saved in the file
+static const htable_hash_t htable_mapped_hashes[] = {
+    htable_hash_wyhash, htable_hash_fnv1a, htable_hash_mult31,
+};
+#define HTABLE_MAPPED_HASHES \
+    (sizeof(htable_mapped_hashes) / sizeof(htable_mapped_hashes[0]))
+
+
+bool htable_save(htable_t *htable, FILE *file) {
+    static const uint64_t zeros[HTABLE_MAPPED_USER];
+    return htable_save_user(htable, file, zeros);
+}
+
+bool htable_save_user(htable_t *htable, FILE *file,
+                      const uint64_t user[HTABLE_MAPPED_USER]) {
+    uint32_t *buckets = NULL;
+    uint64_t *hashes = NULL;  // of the items, so that each key is hashed once
+    htable_mapped_header_t header = {
+        .magic = HTABLE_MAPPED_MAGIC,
+        .hash = HTABLE_MAPPED_HASHES,
+        .count = htable->count,
+        .buckets = 2,
+        .keys_size = 0,
+    };
+    memcpy(header.user, user, sizeof(header.user));
+    for(uint32_t i = 0; i < HTABLE_MAPPED_HASHES; i++) {
+        if(htable->hash == htable_mapped_hashes[i])
+            header.hash = i;
+    }
+    if(header.hash == HTABLE_MAPPED_HASHES || htable->count >= UINT32_MAX) {
+        errno = EINVAL;
+        return false;
+    }
+    while(header.buckets < 2 * header.count)
+        header.buckets *= 2;
+
+    buckets = calloc(header.buckets, sizeof(uint32_t));
+    // malloc(0) could return NULL
+    hashes = malloc((header.count + 1) * sizeof(uint64_t));
+    if(buckets == NULL || hashes == NULL)
+        goto error;
+    uint64_t mask = header.buckets - 1;
+    uint32_t index = 0;
+    for(htable_iterator_t it = htable_begin(htable); it.ptr != NULL;
+            it = htable_it_next(it)) {
+        uint64_t hash = htable->hash(it.ptr->key, it.ptr->len);
+        uint64_t bucket = hash & mask;
+        while(buckets[bucket] != 0)
+            bucket = (bucket + 1) & mask;
+        hashes[index] = hash;
+        buckets[bucket] = ++index;
+        header.keys_size += it.ptr->len + 1;
+    }
+    if(fwrite(&header, sizeof(header), 1, file) != 1 ||
+            fwrite(buckets, sizeof(uint32_t), header.buckets, file) !=
+            header.buckets)
+        goto error;
+    free(buckets);
+    buckets = NULL;
+
+    uint64_t offset = 0;
+    index = 0;
+    for(htable_iterator_t it = htable_begin(htable); it.ptr != NULL;
+            it = htable_it_next(it)) {
+        htable_mapped_item_t item = {
+            .hash = hashes[index++],
+            .key = offset,
+            .data = it.ptr->data,
+            .len = it.ptr->len,
+            .unused = 0,
+        };
+        if(fwrite(&item, sizeof(item), 1, file) != 1)
+            goto error;
+        offset += it.ptr->len + 1;
+    }
+    free(hashes);
+    hashes = NULL;
+    for(htable_iterator_t it = htable_begin(htable); it.ptr != NULL;
+            it = htable_it_next(it)) {
+        if(fwrite(it.ptr->key, 1, it.ptr->len + 1, file) != it.ptr->len + 1)
+            goto error;
+    }
+    // pad the file to 8 bytes
+    static const char zeros[8];
+    size_t padding = (8 - header.keys_size % 8) % 8;
+    if(fwrite(zeros, 1, padding, file) != padding)
+        goto error;
+    return true;
+error:
+    free(buckets);
+    free(hashes);
+    return false;
+}
+
+htable_mapped_t * htable_open_mapped(const char *filename) {
+    htable_mapped_t *mapped = NULL;
+    void *data = MAP_FAILED;
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if(fd == -1)
+        return NULL;
+    if(fstat(fd, &st) == -1)
+        goto error;
+    if((size_t)st.st_size < sizeof(htable_mapped_header_t)) {
+        errno = EINVAL;
+        goto error;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED)
+        goto error;
+    close(fd);
+    fd = -1;
+
+    // the sizes are checked one by one so that none of them can overflow
+    const htable_mapped_header_t *header = data;
+    uint64_t rest = st.st_size - sizeof(htable_mapped_header_t);
+    uint64_t buckets = header->buckets;
+    if(header->magic != HTABLE_MAPPED_MAGIC ||
+            header->hash >= HTABLE_MAPPED_HASHES ||
+            buckets < 2 || (buckets & (buckets - 1)) != 0 ||
+            buckets / 2 < header->count ||
+            buckets > rest / sizeof(uint32_t) ||
+            header->count > (rest - buckets * sizeof(uint32_t)) /
+                            sizeof(htable_mapped_item_t) ||
+            header->keys_size > rest - buckets * sizeof(uint32_t) -
+                                header->count * sizeof(htable_mapped_item_t)) {
+        errno = EINVAL;
+        goto error;
+    }
+
+    mapped = malloc(sizeof(htable_mapped_t));
+    if(mapped == NULL)
+        goto error;
+    mapped->data = data;
+    mapped->size = st.st_size;
+    mapped->hash = htable_mapped_hashes[header->hash];
+    mapped->count = header->count;
+    mapped->mask = buckets - 1;
+    mapped->buckets = (const uint32_t *)(header + 1);
+    mapped->items = (const htable_mapped_item_t *)(mapped->buckets + buckets);
+    mapped->keys = (const char *)(mapped->items + header->count);
+    mapped->keys_size = header->keys_size;
+    mapped->user = header->user;
+    return mapped;
+error:
+    if(data != MAP_FAILED) munmap(data, st.st_size);
+    if(fd != -1) close(fd);
+    return NULL;
+}
+
+void htable_mapped_close(htable_mapped_t **mapped) {
+    munmap((*mapped)->data, (*mapped)->size);
+    free(*mapped);
+    *mapped = NULL;
+}
+
+const char * htable_mapped_key(const htable_mapped_t *mapped,
+                               const htable_mapped_item_t *item) {
+    if(item->key >= mapped->keys_size ||
+            item->len >= mapped->keys_size - item->key)
+        return NULL;
+    return mapped->keys + item->key;
+}
+
+const htable_mapped_item_t * htable_mapped_find(const htable_mapped_t *mapped,
+                                                const char *key, size_t len) {
+    uint64_t hash = mapped->hash(key, len);
+    // at most every bucket, even if the file claims there's no empty one
+    for(uint64_t i = 0, bucket = hash & mapped->mask; i <= mapped->mask;
+            i++, bucket = (bucket + 1) & mapped->mask) {
+        uint32_t index = mapped->buckets[bucket];
+        if(index == 0 || index > mapped->count)
+            return NULL;
+        const htable_mapped_item_t *item = &mapped->items[index - 1];
+        if(item->hash == hash && item->len == len) {
+            const char *item_key = htable_mapped_key(mapped, item);
+            if(item_key != NULL && memcmp(item_key, key, len) == 0)
+                return item;
+        }
+    }
+    return NULL;
+}
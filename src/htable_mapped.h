@@ -0,0 +1,99 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Snapshot of a hash table in a file, which is mapped into memory read-only
+ * and queried right away, without parsing it or inserting the keys again.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __HTABLE_MAPPED_H__
+#define __HTABLE_MAPPED_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "htable.h"
+
+
+/* Numbers saved along with the table, for the program's own use. */
+#define HTABLE_MAPPED_USER 4
+
+typedef struct htable_mapped            htable_mapped_t;
+typedef struct htable_mapped_item       htable_mapped_item_t;
+
+
+struct htable_mapped {
+    void *data;                  // the mapped file
+    size_t size;
+    htable_hash_t hash;          // the hash function of the saved table
+    uint64_t count;              // number of keys
+    uint64_t mask;               // number of buckets - 1
+    const uint32_t *buckets;     // item index + 1 or 0, linear probing
+    const htable_mapped_item_t *items;
+    const char *keys;            // all the keys, each ending with '\0'
+    uint64_t keys_size;
+    const uint64_t *user;        // HTABLE_MAPPED_USER numbers
+};
+
+/* One key of the snapshot, all of them are in the order of iteration of the
+ * saved table. */
+struct htable_mapped_item {
+    uint64_t hash;
+    uint64_t key;                // offset of the key in 'keys'
+    uint64_t data;
+    uint32_t len;
+    uint32_t unused;
+};
+
+
+/**
+ * Write the keys and counts (data) of the table to the file. There are no
+ * pointers in it, only offsets, so it can be mapped anywhere. Only tables
+ * using one of the htable_hash_*() functions can be saved.
+ * @return  False if writing or malloc failed, or if the hash function or the
+ *          number of keys isn't supported (errno is EINVAL).
+ */
+bool htable_save(htable_t *htable, FILE *file);
+
+/* Same as htable_save(), but the 'user' numbers are saved too, instead of
+ * zeros. */
+bool htable_save_user(htable_t *htable, FILE *file,
+                      const uint64_t user[HTABLE_MAPPED_USER]);
+
+/**
+ * Map a file written by htable_save() into memory. Only the header is read,
+ * everything else is read from the disk as the lookups touch it.
+ * @return  The snapshot or NULL if the file isn't valid (errno is EINVAL) or
+ *          can't be opened or mapped.
+ */
+htable_mapped_t * htable_open_mapped(const char *filename);
+
+/* Unmap the file and free the snapshot. */
+void htable_mapped_close(htable_mapped_t **mapped);
+
+/**
+ * Find the key, hashed by the same function as in the saved table.
+ * @return  The item of the key or NULL if it's not in the snapshot.
+ */
+const htable_mapped_item_t * htable_mapped_find(const htable_mapped_t *mapped,
+                                                const char *key, size_t len);
+
+/* The key of the item, terminated by '\0', or NULL if the file is corrupted
+ * and the key isn't inside it. */
+const char * htable_mapped_key(const htable_mapped_t *mapped,
+                               const htable_mapped_item_t *item);
+
+#endif /* __HTABLE_MAPPED_H__ */
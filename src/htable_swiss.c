@@ -0,0 +1,246 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__SSE2__) && !defined(HTABLE_NO_SSE2)
+#include <emmintrin.h>
+#define HTABLE_USE_SSE2
+#endif
+
+#include "htable.h"
+#include "htable_internal.h"
+
+/*
+ * Open addressing backend of the hash table (HTABLE_SWISS), in the style of
+ * the "Swiss tables". Instead of lists, there is an array of slots, each of
+ * them pointing to an item, and a parallel array of control bytes:
+ *
+ *   ctrl:  [ 0x80 | 0x15 | 0x80 | 0x7f | ... ]  (groups of 16 bytes)
+ *   slots: [ NULL | item | NULL | item | ... ]
+ *
+ * The control byte is HTABLE_EMPTY for an empty slot, or the lowest 7 bits of
+ * the hash of the key in the slot (the fingerprint). The rest of the hash
+ * chooses the group of 16 slots where the search starts. All 16 control bytes
+ * of a group are compared with the fingerprint at once (with SSE2 if
+ * available), so the keys are compared only in the slots where the
+ * fingerprint matches, which is almost always just the right one. If the
+ * group has no match and contains an empty slot, the key isn't in the table.
+ * Otherwise the search continues in the next group, with the distance to it
+ * growing by one group each time (which visits every group exactly once,
+ * since the number of groups is a power of two).
+ *
+ * Items are never removed, so there are no tombstones. When the table gets
+ * 7/8 full, the slot arrays are doubled and the pointers re-inserted; the
+ * items themselves don't move, so the pointers returned by htable_lookup()
+ * stay valid.
+ */
+
+#define HTABLE_GROUP 16
+#define HTABLE_EMPTY 0x80
+
+
+/* Mix the bits of the hash, since simple hash functions like
+ * htable_hash_mult31() don't spread short keys over the upper bits (finalizer
+ * from MurmurHash3). */
+static uint64_t htable_swiss_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* Bit mask of the control bytes in the group that are equal to 'byte'. */
+static unsigned int htable_group_match(const unsigned char *ctrl,
+                                       unsigned char byte) {
+#ifdef HTABLE_USE_SSE2
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    __m128i match = _mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte));
+    return (unsigned int)_mm_movemask_epi8(match);
+#else
+    unsigned int mask = 0;
+    for(int i = 0; i < HTABLE_GROUP; i++) {
+        if(ctrl[i] == byte)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+static unsigned int htable_lowest_bit(unsigned int mask) {
+    return (unsigned int)__builtin_ctz(mask);
+}
+
+static bool htable_swiss_alloc(htable_t *htable, unsigned int size) {
+    unsigned char *ctrl = malloc(size);
+    htable_listitem_t **slots = calloc(size, sizeof(htable_listitem_t *));
+    if(ctrl == NULL || slots == NULL) {
+        free(ctrl);
+        free(slots);
+        return false;
+    }
+    memset(ctrl, HTABLE_EMPTY, size);
+    htable->ctrl = ctrl;
+    htable->slots = slots;
+    htable->size = size;
+    return true;
+}
+
+bool htable_swiss_init(htable_t *htable, unsigned int size) {
+    unsigned int slots = HTABLE_GROUP;
+    while(slots < size && slots <= UINT32_MAX / 2)
+        slots *= 2;
+    return htable_swiss_alloc(htable, slots);
+}
+
+/* Find the empty slot where a key with the given hash belongs. */
+static unsigned int htable_swiss_find_empty(const htable_t *htable,
+                                            uint64_t hash) {
+    unsigned int group_mask = htable->size / HTABLE_GROUP - 1;
+    unsigned int group = (unsigned int)(hash >> 7) & group_mask;
+    for(unsigned int step = 1; ; step++) {
+        const unsigned char *ctrl = htable->ctrl + group * HTABLE_GROUP;
+        unsigned int empty = htable_group_match(ctrl, HTABLE_EMPTY);
+        if(empty != 0)
+            return group * HTABLE_GROUP + htable_lowest_bit(empty);
+        group = (group + step) & group_mask;
+    }
+}
+
+/* Double the number of slots and re-insert all the items. If malloc fails,
+ * keep the old slots, the table still has at least 1/8 of them empty. */
+static void htable_swiss_grow(htable_t *htable) {
+    unsigned char *old_ctrl = htable->ctrl;
+    htable_listitem_t **old_slots = htable->slots;
+    unsigned int old_size = htable->size;
+
+    if(old_size > UINT32_MAX / 2 ||
+            !htable_swiss_alloc(htable, old_size * 2))
+        return;
+    for(unsigned int i = 0; i < old_size; i++) {
+        if(old_ctrl[i] == HTABLE_EMPTY)
+            continue;
+        uint64_t hash = htable_swiss_mix(htable_hash(htable,
+                                                   old_slots[i]->key,
+                                                   old_slots[i]->len));
+        unsigned int slot = htable_swiss_find_empty(htable, hash);
+        htable->ctrl[slot] = old_ctrl[i];
+        htable->slots[slot] = old_slots[i];
+    }
+    free(old_ctrl);
+    free(old_slots);
+}
+
+void htable_swiss_prefetch(const htable_t *htable, uint64_t key_hash) {
+    uint64_t hash = htable_swiss_mix(key_hash);
+    unsigned int group_mask = htable->size / HTABLE_GROUP - 1;
+    unsigned int group = (unsigned int)(hash >> 7) & group_mask;
+    __builtin_prefetch(htable->ctrl + group * HTABLE_GROUP);
+    __builtin_prefetch(htable->slots + group * HTABLE_GROUP);
+}
+
+htable_listitem_t * htable_swiss_lookup(htable_t *htable, const char *key,
+                                        size_t len, uint64_t key_hash) {
+    uint64_t hash = htable_swiss_mix(key_hash);
+    htable_str_t str = {key, len};
+    unsigned char fingerprint = hash & 0x7f;
+    unsigned int group_mask = htable->size / HTABLE_GROUP - 1;
+    unsigned int group = (unsigned int)(hash >> 7) & group_mask;
+
+    for(unsigned int step = 1; step <= group_mask + 1; step++) {
+        const unsigned char *ctrl = htable->ctrl + group * HTABLE_GROUP;
+        unsigned int match = htable_group_match(ctrl, fingerprint);
+        while(match != 0) {
+            unsigned int slot = group * HTABLE_GROUP + htable_lowest_bit(match);
+            if(htable_listitem_eq(htable->slots[slot], str)) {
+                HTABLE_COUNT_PROBES(htable, step);
+                htable->slots[slot]->data++;
+                return htable->slots[slot];
+            }
+            match &= match - 1;
+        }
+        unsigned int empty = htable_group_match(ctrl, HTABLE_EMPTY);
+        if(empty != 0) {
+            // not found, the key goes into the first empty slot
+            HTABLE_COUNT_PROBES(htable, step);
+            htable_listitem_t *item = htable_new_item(htable, key, len);
+            if(item == NULL)
+                return NULL;
+            unsigned int slot = group * HTABLE_GROUP + htable_lowest_bit(empty);
+            htable->ctrl[slot] = fingerprint;
+            htable->slots[slot] = item;
+            htable->count++;
+            if(htable->count > htable->size / 8 * 7)
+                htable_swiss_grow(htable);
+            return item;
+        }
+        group = (group + step) & group_mask;
+    }
+    // all the slots are full, which happens only if growing failed
+    return NULL;
+}
+
+htable_listitem_t * htable_swiss_find(const htable_t *htable, const char *key,
+                                      size_t len, uint64_t key_hash) {
+    uint64_t hash = htable_swiss_mix(key_hash);
+    htable_str_t str = {key, len};
+    unsigned char fingerprint = hash & 0x7f;
+    unsigned int group_mask = htable->size / HTABLE_GROUP - 1;
+    unsigned int group = (unsigned int)(hash >> 7) & group_mask;
+
+    for(unsigned int step = 1; step <= group_mask + 1; step++) {
+        const unsigned char *ctrl = htable->ctrl + group * HTABLE_GROUP;
+        unsigned int match = htable_group_match(ctrl, fingerprint);
+        while(match != 0) {
+            unsigned int slot = group * HTABLE_GROUP + htable_lowest_bit(match);
+            if(htable_listitem_eq(htable->slots[slot], str))
+                return htable->slots[slot];
+            match &= match - 1;
+        }
+        if(htable_group_match(ctrl, HTABLE_EMPTY) != 0)
+            return NULL;
+        group = (group + step) & group_mask;
+    }
+    return NULL;
+}
+
+void htable_swiss_stats(const htable_t *htable, htable_stats_t *stats) {
+    unsigned int group_mask = htable->size / HTABLE_GROUP - 1;
+    for(unsigned int slot = 0; slot < htable->size; slot++) {
+        if(htable->ctrl[slot] == HTABLE_EMPTY)
+            continue;
+        // follow the probe sequence of the key until its group
+        uint64_t hash = htable_swiss_mix(htable_hash(htable,
+                                                   htable->slots[slot]->key,
+                                                   htable->slots[slot]->len));
+        unsigned int group = (unsigned int)(hash >> 7) & group_mask;
+        unsigned long length = 0;
+        for(unsigned int step = 1; group != slot / HTABLE_GROUP; step++) {
+            group = (group + step) & group_mask;
+            length++;
+        }
+        stats->lengths[length < HTABLE_STATS_LENGTHS
+                       ? length : HTABLE_STATS_LENGTHS - 1]++;
+        if(length > stats->max_length)
+            stats->max_length = length;
+    }
+    stats->table_bytes = htable->size * (1 + sizeof(htable_listitem_t *));
+}
@@ -14,16 +14,30 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE  // madvise()
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <stdbool.h>
 #include <ctype.h>
 #include <assert.h>
 
 #include "io.h"
+#include "scan.h"
 
 static bool warning_printed = false;
 
+// size of the blocks read from inputs that can't be mapped into memory
+#define TOKENIZER_BLOCK (64 * 1024)
+
+// the pages of a mapped file are released after reading this many bytes, so
+// that they don't count towards the memory used by the process
+#define TOKENIZER_RELEASE (64 * 1024 * 1024)
+
 
 int read_word(char *out, unsigned int max, FILE *file) {
     assert(max > 2); // have space for at least one char + '\0'
@@ -56,3 +70,165 @@ int read_word(char *out, unsigned int max, FILE *file) {
     else             out[i] = '\0';
     return i;
 }
+
+int tokenizer_open(tokenizer_t *tokenizer, FILE *file) {
+    tokenizer_init_memory(tokenizer, NULL, 0);
+
+    struct stat st;
+    off_t start = ftello(file);
+    if(fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) && start >= 0) {
+        if(st.st_size <= start)
+            return 0;  // nothing to read
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                         fileno(file), 0);
+        if(map == MAP_FAILED)
+            return errno;
+        posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+        tokenizer->map = map;
+        tokenizer->map_size = st.st_size;
+        tokenizer->data = map;
+        tokenizer->size = st.st_size;
+        tokenizer->pos = start;
+        // nothing before 'start' is read, so there is nothing to release
+        tokenizer->released = start / TOKENIZER_RELEASE * TOKENIZER_RELEASE;
+        return 0;
+    }
+
+    // not a regular file, read it in blocks
+    tokenizer->buffer = malloc(TOKENIZER_BLOCK);
+    if(tokenizer->buffer == NULL)
+        return ENOMEM;
+    tokenizer->capacity = TOKENIZER_BLOCK;
+    tokenizer->data = tokenizer->buffer;
+    tokenizer->file = file;
+    return 0;
+}
+
+void tokenizer_init_memory(tokenizer_t *tokenizer, const char *data,
+                           size_t size) {
+    tokenizer->data = data;
+    tokenizer->size = size;
+    tokenizer->pos = 0;
+    tokenizer->file = NULL;
+    tokenizer->buffer = NULL;
+    tokenizer->capacity = 0;
+    tokenizer->map = NULL;
+    tokenizer->map_size = 0;
+    tokenizer->released = 0;
+    tokenizer->mask_valid = false;
+    tokenizer->error = 0;
+}
+
+/* Read the next block of the file into the buffer, keeping the bytes from
+ * 'keep' on (the beginning of an unfinished word). The buffer is doubled when
+ * the word fills all of it.
+ * @return false at the end of file or on error. */
+static bool tokenizer_fill(tokenizer_t *tokenizer, size_t keep) {
+    if(tokenizer->file == NULL)
+        return false;
+    size_t kept = tokenizer->size - keep;
+    memmove(tokenizer->buffer, tokenizer->buffer + keep, kept);
+    tokenizer->mask_valid = false;
+    tokenizer->pos -= keep;
+    tokenizer->size = kept;
+    if(kept == tokenizer->capacity) {
+        char *buffer = realloc(tokenizer->buffer, tokenizer->capacity * 2);
+        if(buffer == NULL) {
+            tokenizer->error = ENOMEM;
+            return false;
+        }
+        tokenizer->buffer = buffer;
+        tokenizer->data = buffer;
+        tokenizer->capacity *= 2;
+    }
+
+    size_t n = fread(tokenizer->buffer + kept, 1,
+                     tokenizer->capacity - kept, tokenizer->file);
+    tokenizer->size += n;
+    if(n == 0) {
+        if(ferror(tokenizer->file))
+            tokenizer->error = errno ? errno : EIO;
+        return false;
+    }
+    return true;
+}
+
+/* Offset of the first whitespace ('space' true) or other character in
+ * data[pos..size), or size. Uses the whitespace mask of 64 bytes from the
+ * previous call while 'pos' is inside of it. */
+static size_t tokenizer_find(tokenizer_t *tokenizer, size_t pos, bool space) {
+    while(pos < tokenizer->size) {
+        if(!tokenizer->mask_valid || pos < tokenizer->mask_start ||
+                pos >= tokenizer->mask_start + 64) {
+            if(pos + 64 > tokenizer->size) {
+                // not enough bytes left for a whole mask
+                return space ? scan_space(tokenizer->data, pos,
+                                          tokenizer->size)
+                             : scan_nonspace(tokenizer->data, pos,
+                                             tokenizer->size);
+            }
+            tokenizer->mask = scan_mask64(tokenizer->data + pos);
+            tokenizer->mask_start = pos;
+            tokenizer->mask_valid = true;
+        }
+        uint64_t mask = space ? tokenizer->mask : ~tokenizer->mask;
+        mask >>= pos - tokenizer->mask_start;
+        if(mask != 0)
+            return pos + __builtin_ctzll(mask);
+        pos = tokenizer->mask_start + 64;
+    }
+    return tokenizer->size;
+}
+
+const char * tokenizer_next(tokenizer_t *tokenizer, size_t *len) {
+    // skip the whitespace before the word
+    for(;;) {
+        tokenizer->pos = tokenizer_find(tokenizer, tokenizer->pos, false);
+        if(tokenizer->pos < tokenizer->size)
+            break;
+        if(!tokenizer_fill(tokenizer, tokenizer->size))
+            return NULL;
+    }
+    // same as read_word(), '\0' instead of a word ends the input
+    if(tokenizer->data[tokenizer->pos] == '\0')
+        return NULL;
+
+    // find the end of the word
+    size_t start = tokenizer->pos;
+    size_t end = start + 1;
+    for(;;) {
+        end = tokenizer_find(tokenizer, end, true);
+        if(end < tokenizer->size)
+            break;
+        // the word may continue in the next block
+        tokenizer->pos = start;
+        size_t offset = end - start;
+        if(!tokenizer_fill(tokenizer, start)) {
+            start = tokenizer->pos;
+            end = start + offset;
+            break;
+        }
+        start = tokenizer->pos;
+        end = start + offset;
+    }
+    tokenizer->pos = end;
+    *len = end - start;
+    if(tokenizer->map != NULL &&
+            start - tokenizer->released >= TOKENIZER_RELEASE) {
+        // all the whole blocks before the word at once, they are aligned to
+        // pages, since the mapping is
+        size_t size = (start - tokenizer->released) / TOKENIZER_RELEASE *
+                      TOKENIZER_RELEASE;
+        madvise((char *)tokenizer->map + tokenizer->released, size,
+                MADV_DONTNEED);
+        tokenizer->released += size;
+    }
+    return tokenizer->data + start;
+}
+
+void tokenizer_close(tokenizer_t *tokenizer) {
+    if(tokenizer->map != NULL)
+        munmap(tokenizer->map, tokenizer->map_size);
+    free(tokenizer->buffer);
+    tokenizer_init_memory(tokenizer, NULL, 0);
+}
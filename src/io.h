@@ -17,7 +17,37 @@
 #ifndef __IO_H__
 #define __IO_H__
 
+#include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct tokenizer            tokenizer_t;
+
+/*
+ * Splits the input into words, the same way as read_word() (in the "C"
+ * locale) but without copying them and without any limit on their length.
+ * Whitespace is found with vector instructions (see scan.h). Regular files are
+ * mapped into memory, other inputs (pipes, terminals) are read in large
+ * blocks into a buffer.
+ */
+struct tokenizer {
+    const char *data;   // the mapping, the buffer, or the memory given
+    size_t size;        // number of valid bytes in 'data'
+    size_t pos;         // offset of the next byte to split
+    FILE *file;         // NULL if the whole input is in 'data'
+    char *buffer;
+    size_t capacity;    // size of 'buffer'
+    void *map;          // mapping of the file, to be unmapped
+    size_t map_size;
+    size_t released;    // the mapping before this offset was already read
+    // whitespace mask (see scan_mask64()) of data[mask_start..mask_start+64)
+    uint64_t mask;
+    size_t mask_start;
+    bool mask_valid;
+    int error;          // errno of a failed read, or 0
+};
 
 /**
  * Read a word (characters separated from others by `isspace` characters -
@@ -36,4 +66,29 @@
  */
 int read_word(char *out, unsigned int max, FILE *file);
 
+/**
+ * Prepare the tokenizer for reading the file from its current position. The
+ * file has to stay open until tokenizer_close() is called.
+ * @return 0 or errno if the mapping or malloc failed.
+ */
+int tokenizer_open(tokenizer_t *tokenizer, FILE *file);
+
+/* Prepare the tokenizer for splitting 'size' bytes of memory. */
+void tokenizer_init_memory(tokenizer_t *tokenizer, const char *data,
+                           size_t size);
+
+/**
+ * Find the next word.
+ * @param len: Output for the length of the word.
+ * @return: Pointer to the first character of the word, which is not
+ *      terminated by '\0'. It's valid only until the next call, unless
+ *      tokenizer->file is NULL (the whole input is in memory), then it stays
+ *      valid until tokenizer_close(). NULL if the end of input was reached
+ *      (check tokenizer->error for read errors).
+ */
+const char * tokenizer_next(tokenizer_t *tokenizer, size_t *len);
+
+/* Free the buffer or the mapping, does not close the file. */
+void tokenizer_close(tokenizer_t *tokenizer);
+
 #endif /* __IO_H__ */
@@ -0,0 +1,278 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define NORMALIZE_SSE2
+#endif
+
+#include "normalize.h"
+
+/*
+ * Almost all words are ASCII, so lowercasing first assumes the word is: 16
+ * bytes at a time, the bytes are checked for the high bit and 'A' to 'Z' get
+ * 0x20 added. Only when a byte with the high bit turns up, the whole word is
+ * done again, decoding it as UTF-8. All the upper case letters that are
+ * lowercased are two bytes long in UTF-8, and so are their lower case
+ * versions, so the length of the word never changes.
+ */
+
+// the capacity normalize_copy() starts with
+#define NORMALIZE_COPY_MIN 64
+
+
+/* Decode the UTF-8 character at the start of s[0..len).
+ * @return its length or 0 if it isn't valid UTF-8 (overlong, a surrogate,
+ *      cut short by the end of the word...). */
+static size_t normalize_decode(const unsigned char *s, size_t len,
+                               uint32_t *c) {
+    size_t n;
+    uint32_t min;
+    if(s[0] < 0x80) {
+        *c = s[0];
+        return 1;
+    }
+    else if((s[0] & 0xe0) == 0xc0) {
+        n = 2;
+        min = 0x80;
+        *c = s[0] & 0x1f;
+    }
+    else if((s[0] & 0xf0) == 0xe0) {
+        n = 3;
+        min = 0x800;
+        *c = s[0] & 0x0f;
+    }
+    else if((s[0] & 0xf8) == 0xf0) {
+        n = 4;
+        min = 0x10000;
+        *c = s[0] & 0x07;
+    }
+    else {
+        return 0;
+    }
+    if(n > len)
+        return 0;
+    for(size_t i = 1; i < n; i++) {
+        if((s[i] & 0xc0) != 0x80)
+            return 0;
+        *c = (*c << 6) | (s[i] & 0x3f);
+    }
+    if(*c < min || *c > 0x10ffff || (*c >= 0xd800 && *c <= 0xdfff))
+        return 0;
+    return n;
+}
+
+/* Lower case of a character of Latin-1, Latin Extended-A, Greek or
+ * Cyrillic, other characters are returned as they are. */
+static uint32_t normalize_lower_wide(uint32_t c) {
+    if((c >= 0xc0 && c <= 0xde && c != 0xd7) ||     // Latin-1
+            (c >= 0x391 && c <= 0x3ab && c != 0x3a2) ||  // Greek
+            (c >= 0x410 && c <= 0x42f))             // Cyrillic
+        return c + 0x20;
+    if(c >= 0x400 && c <= 0x40f)                    // Cyrillic with marks
+        return c + 0x50;
+    // Latin Extended-A mostly alternates upper and lower case
+    if((c >= 0x100 && c <= 0x12f) || (c >= 0x132 && c <= 0x137) ||
+            (c >= 0x14a && c <= 0x177))
+        return c | 1;
+    if((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17e))
+        return (c & 1) ? c + 1 : c;
+    if(c == 0x178)                                  // Y with diaeresis
+        return 0xff;
+    // Greek with tonos
+    if(c == 0x386) return 0x3ac;
+    if(c >= 0x388 && c <= 0x38a) return c + 0x25;
+    if(c == 0x38c) return 0x3cc;
+    if(c == 0x38e || c == 0x38f) return c + 0x3f;
+    return c;
+}
+
+/* Lowercase a word that isn't only ASCII. */
+static void normalize_lower_utf8(char *word, size_t len) {
+    unsigned char *s = (unsigned char *)word;
+    for(size_t i = 0; i < len; ) {
+        if(s[i] < 0x80) {
+            if((unsigned char)(s[i] - 'A') < 26)
+                s[i] += 'a' - 'A';
+            i++;
+            continue;
+        }
+        uint32_t c;
+        size_t n = normalize_decode(s + i, len - i, &c);
+        if(n == 0) {
+            // not UTF-8, the byte is left as it is
+            i++;
+            continue;
+        }
+        if(n == 2) {
+            c = normalize_lower_wide(c);
+            s[i] = 0xc0 | (c >> 6);
+            s[i + 1] = 0x80 | (c & 0x3f);
+        }
+        i += n;
+    }
+}
+
+#ifdef NORMALIZE_SSE2
+/* Lowercase 16 ASCII bytes. @return false (and don't change them) if any of
+ * them isn't ASCII. */
+static bool normalize_lower16(char *p) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    if(_mm_movemask_epi8(v) != 0)
+        return false;
+    // 'A' to 'Z' are shifted to the 26 lowest signed bytes
+    __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(-128 - 'A')));
+    __m128i upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 26));
+    v = _mm_add_epi8(v, _mm_and_si128(upper, _mm_set1_epi8('a' - 'A')));
+    _mm_storeu_si128((__m128i *)p, v);
+    return true;
+}
+#endif
+
+/* Lowercase an ASCII word. @return false if the word isn't ASCII, then it
+ * may be lowercased only partly. */
+static bool normalize_lower_ascii(char *word, size_t len) {
+    size_t i = 0;
+#ifdef NORMALIZE_SSE2
+    for(; i + 16 <= len; i += 16) {
+        if(!normalize_lower16(word + i))
+            return false;
+    }
+    if(i < len) {
+        // the rest goes through a copy, so that nothing after the word is
+        // read or written
+        char block[16];
+        memcpy(block, word + i, len - i);
+        memset(block + (len - i), 0, 16 - (len - i));
+        if(!normalize_lower16(block))
+            return false;
+        memcpy(word + i, block, len - i);
+    }
+#else
+    for(; i < len; i++) {
+        unsigned char c = word[i];
+        if(c >= 0x80)
+            return false;
+        if((unsigned char)(c - 'A') < 26)
+            word[i] = c + ('a' - 'A');
+    }
+#endif
+    return true;
+}
+
+/* Length of the character at the start of s[0..len) if it's one of those
+ * to strip, otherwise 0. */
+static size_t normalize_strip_length(const normalizer_t *normalizer,
+                                     const unsigned char *s, size_t len) {
+    if(s[0] < 0x80)
+        return (normalizer->ascii[s[0] >> 6] >> (s[0] & 63)) & 1;
+    uint32_t c;
+    size_t n = normalize_decode(s, len, &c);
+    if(n == 0)
+        return 0;
+    for(unsigned int i = 0; i < normalizer->wide_count; i++) {
+        if(normalizer->wide[i] == c)
+            return n;
+    }
+    return 0;
+}
+
+bool normalizer_init(normalizer_t *normalizer, bool lower,
+                     const char *strip) {
+    memset(normalizer, 0, sizeof(normalizer_t));
+    normalizer->lower = lower;
+    if(strip == NULL)
+        return true;
+    const unsigned char *s = (const unsigned char *)strip;
+    size_t len = strlen(strip);
+    for(size_t i = 0; i < len; ) {
+        uint32_t c;
+        size_t n = normalize_decode(s + i, len - i, &c);
+        if(n == 0) {
+            errno = EINVAL;
+            return false;
+        }
+        i += n;
+        normalizer->strip = true;
+        if(c < 0x80) {
+            normalizer->ascii[c >> 6] |= (uint64_t)1 << (c & 63);
+            continue;
+        }
+        bool known = false;
+        for(unsigned int j = 0; j < normalizer->wide_count; j++)
+            known = known || normalizer->wide[j] == c;
+        if(known)
+            continue;
+        if(normalizer->wide_count == NORMALIZE_WIDE) {
+            errno = EINVAL;
+            return false;
+        }
+        normalizer->wide[normalizer->wide_count++] = c;
+    }
+    return true;
+}
+
+bool normalize_enabled(const normalizer_t *normalizer) {
+    return normalizer->lower || normalizer->strip;
+}
+
+char * normalize(const normalizer_t *normalizer, char *word, size_t *len) {
+    if(normalizer->lower && !normalize_lower_ascii(word, *len))
+        normalize_lower_utf8(word, *len);
+    if(!normalizer->strip)
+        return word;
+
+    const unsigned char *s = (const unsigned char *)word;
+    size_t start = 0, end = *len;
+    while(start < end) {
+        size_t n = normalize_strip_length(normalizer, s + start, end - start);
+        if(n == 0)
+            break;
+        start += n;
+    }
+    while(end > start) {
+        // find where the last character starts, it's at most 4 bytes long
+        size_t last = end - 1;
+        while(last > start && end - last < 4 && (s[last] & 0xc0) == 0x80)
+            last--;
+        if(normalize_strip_length(normalizer, s + last, end - last) !=
+                end - last)
+            break;
+        end = last;
+    }
+    *len = end - start;
+    return word + start;
+}
+
+const char * normalize_copy(const normalizer_t *normalizer, const char *word,
+                            size_t *len, char **buffer, size_t *capacity) {
+    if(!normalize_enabled(normalizer))
+        return word;
+    if(*len > *capacity || *buffer == NULL) {
+        size_t size = (*len > NORMALIZE_COPY_MIN) ? *len : NORMALIZE_COPY_MIN;
+        char *grown = realloc(*buffer, size);
+        if(grown == NULL)
+            return NULL;
+        *buffer = grown;
+        *capacity = size;
+    }
+    memcpy(*buffer, word, *len);
+    return normalize(normalizer, *buffer, len);
+}
@@ -0,0 +1,81 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Normalization of the words between the tokenizer and the hash table, so
+ * that "Dog", "dog," and "dog." are counted as the same word: lowercasing,
+ * and stripping punctuation (or any other chosen characters) from the start
+ * and the end of words. ASCII words are lowercased 16 bytes at a time with
+ * SSE2; a word with other bytes is decoded as UTF-8 and the letters of
+ * Latin-1, Latin Extended-A, Greek and Cyrillic are lowercased as well.
+ * Bytes that aren't valid UTF-8 (like the ISO-8859 of some inputs) are left
+ * as they are.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NORMALIZE_H__
+#define __NORMALIZE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct normalizer           normalizer_t;
+
+// ASCII punctuation, what ispunct() matches in the "C" locale
+#define NORMALIZE_PUNCT "!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~"
+
+// the most non-ASCII characters that can be stripped
+#define NORMALIZE_WIDE 32
+
+struct normalizer {
+    bool lower;             // lowercase the words
+    bool strip;             // strip characters from their ends
+    uint64_t ascii[2];      // bit mask of the ASCII characters to strip
+    uint32_t wide[NORMALIZE_WIDE];  // the other ones, as code points
+    unsigned int wide_count;
+};
+
+
+/**
+ * Prepare the normalization.
+ * @param strip  UTF-8 string of the characters to strip, or NULL.
+ * @return false if 'strip' isn't valid UTF-8 or has more than
+ *      NORMALIZE_WIDE different non-ASCII characters.
+ */
+bool normalizer_init(normalizer_t *normalizer, bool lower,
+                     const char *strip);
+
+/* Whether the normalization changes anything at all. */
+bool normalize_enabled(const normalizer_t *normalizer);
+
+/**
+ * Normalize the word in place. Lowercasing doesn't change the length of the
+ * word, stripping moves its start and end.
+ * @param len  Length of the word, set to the normalized length (0 if only
+ *      stripped characters were in the word).
+ * @return  The start of the normalized word, within 'word'.
+ */
+char * normalize(const normalizer_t *normalizer, char *word, size_t *len);
+
+/**
+ * Same as normalize(), but the word is first copied into '*buffer', which is
+ * (re)allocated if it's smaller than the word and has to be freed. Without
+ * any normalization, the word itself is returned.
+ * @return  The normalized word or NULL if malloc failed.
+ */
+const char * normalize_copy(const normalizer_t *normalizer, const char *word,
+                            size_t *len, char **buffer, size_t *capacity);
+
+#endif /* __NORMALIZE_H__ */
@@ -0,0 +1,132 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "out.h"
+
+// the most digits of a uint64_t
+#define OUT_UINT_DIGITS 20
+
+// "00" to "99", so that numbers are converted two digits at a time
+static const char out_digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+
+
+int out_init(out_t *out, int fd, size_t size) {
+    out->fd = fd;
+    out->buffer = malloc(size);
+    out->size = size;
+    out->used = 0;
+    return out->buffer != NULL ? 0 : -1;
+}
+
+void out_free(out_t *out) {
+    free(out->buffer);
+    out->buffer = NULL;
+    out->size = 0;
+    out->used = 0;
+}
+
+int out_write_all(int fd, const char *data, size_t len) {
+    while(len > 0) {
+        ssize_t written = write(fd, data, len);
+        if(written < 0 && errno == EINTR) continue;
+        if(written < 0) return -1;
+        data += written;
+        len -= written;
+    }
+    return 0;
+}
+
+/* Write the buffer and then the data, with as few writev() calls as the
+ * kernel allows. The buffer is empty afterwards, even if writing failed. */
+static int out_writev(out_t *out, const char *data, size_t len) {
+    struct iovec iov[2] = {
+        {.iov_base = out->buffer, .iov_len = out->used},
+        {.iov_base = (char *)data, .iov_len = len},
+    };
+    struct iovec *next = iov;
+    int count = 2;
+    out->used = 0;
+    while(count > 0) {
+        ssize_t written = writev(out->fd, next, count);
+        if(written < 0 && errno == EINTR) continue;
+        if(written < 0) return -1;
+        // skip what was written, the rest is tried again
+        while(count > 0 && (size_t)written >= next->iov_len) {
+            written -= next->iov_len;
+            next++;
+            count--;
+        }
+        if(count > 0) {
+            next->iov_base = (char *)next->iov_base + written;
+            next->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+int out_write(out_t *out, const char *data, size_t len) {
+    if(len > out->size - out->used)
+        return out_writev(out, data, len);
+    memcpy(out->buffer + out->used, data, len);
+    out->used += len;
+    return 0;
+}
+
+int out_char(out_t *out, char c) {
+    if(out->used == out->size && out_flush(out) != 0)
+        return -1;
+    out->buffer[out->used++] = c;
+    return 0;
+}
+
+/* The digits are written from the end of a small array, two at a time. */
+int out_uint(out_t *out, uint64_t value) {
+    char digits[OUT_UINT_DIGITS];
+    char *p = digits + OUT_UINT_DIGITS;
+    while(value >= 100) {
+        unsigned int pair = (unsigned int)(value % 100) * 2;
+        value /= 100;
+        p -= 2;
+        p[0] = out_digit_pairs[pair];
+        p[1] = out_digit_pairs[pair + 1];
+    }
+    if(value >= 10) {
+        p -= 2;
+        p[0] = out_digit_pairs[value * 2];
+        p[1] = out_digit_pairs[value * 2 + 1];
+    }
+    else {
+        *--p = '0' + (char)value;
+    }
+    return out_write(out, p, digits + OUT_UINT_DIGITS - p);
+}
+
+int out_flush(out_t *out) {
+    int res = out_write_all(out->fd, out->buffer, out->used);
+    out->used = 0;
+    return res;
+}
@@ -0,0 +1,71 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Buffered output to a file descriptor, used instead of stdio by the
+ * programs that print millions of lines: there is no format string to parse
+ * and no lock to take for every line, numbers are converted by hand, and a
+ * full buffer is written together with the data that didn't fit into it by
+ * a single writev().
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __OUT_H__
+#define __OUT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct out                  out_t;
+
+// default size of the buffer
+#define OUT_BUFFER (256 * 1024)
+
+struct out {
+    int fd;
+    char *buffer;
+    size_t size;        // size of 'buffer'
+    size_t used;        // bytes of 'buffer' not written yet
+};
+
+
+/**
+ * Prepare the output to the file descriptor, with a buffer of 'size' bytes.
+ * @return 0 or -1 if malloc failed.
+ */
+int out_init(out_t *out, int fd, size_t size);
+
+/* Free the buffer, without writing what's left in it (see out_flush()). */
+void out_free(out_t *out);
+
+/**
+ * Write 'len' bytes. They are only copied into the buffer, unless it's full.
+ * @return 0 or -1 if writing failed (errno is set).
+ */
+int out_write(out_t *out, const char *data, size_t len);
+
+/* Same as out_write() of one character. */
+int out_char(out_t *out, char c);
+
+/* Same as out_write() of the decimal digits of the number. */
+int out_uint(out_t *out, uint64_t value);
+
+/* Write everything that's in the buffer. @return 0 or -1 (errno is set). */
+int out_flush(out_t *out);
+
+/* Write all of the data to the file descriptor right away, retrying after
+ * short writes and EINTR. @return 0 or -1 (errno is set). */
+int out_write_all(int fd, const char *data, size_t len);
+
+#endif /* __OUT_H__ */
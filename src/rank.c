@@ -0,0 +1,189 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "rank.h"
+
+/* The first 8 bytes of the key (fewer if it's shorter) as a number that
+ * compares the same way as the bytes. */
+static uint64_t rank_prefix(const char *key, unsigned int len) {
+    uint64_t prefix = 0;
+    for(unsigned int i = 0; i < 8 && i < len; i++)
+        prefix |= (uint64_t)(unsigned char)key[i] << (56 - 8 * i);
+    return prefix;
+}
+
+static rank_entry_t rank_entry(const htable_listitem_t *item) {
+    rank_entry_t entry = {rank_prefix(item->key, item->len), item->key,
+                          item->len, item->data};
+    return entry;
+}
+
+static int rank_compare_key(const void *a, const void *b) {
+    const rank_entry_t *x = a, *y = b;
+    if(x->prefix != y->prefix) return (x->prefix < y->prefix) ? -1 : 1;
+    // the same 8 bytes, or the same shorter key padded with zeros
+    unsigned int len = (x->len < y->len) ? x->len : y->len;
+    int cmp = memcmp(x->key, y->key, len);
+    if(cmp != 0) return cmp;
+    if(x->len != y->len) return (x->len < y->len) ? -1 : 1;
+    return 0;
+}
+
+static int rank_compare_count(const void *a, const void *b) {
+    const rank_entry_t *x = a, *y = b;
+    if(x->count != y->count) return (x->count > y->count) ? -1 : 1;
+    return rank_compare_key(a, b);
+}
+
+// bytes of the prefix and the count used as radix sort digits
+#define RANK_DIGITS 16
+
+/* Digit 'd' of the radix sort key of the entry, the least significant
+ * first. The prefix goes first, then the count inverted, so that the
+ * highest count comes first. */
+static inline unsigned int rank_digit(const rank_entry_t *entry, int d) {
+    if(d < 8) return (entry->prefix >> (8 * d)) & 0xff;
+    return (~entry->count >> (8 * (d - 8))) & 0xff;
+}
+
+/*
+ * Large arrays are sorted with a least significant digit radix sort over the
+ * prefixes (and counts), which needs no comparisons and goes over the array
+ * sequentially. The histograms of all the digits are collected in a single
+ * pass first, so a digit that's the same everywhere (like the high bytes of
+ * the counts) costs nothing. Only entries with the same prefix (and count)
+ * still have to be compared as whole keys, afterwards.
+ */
+void rank_sort(rank_entry_t *entries, size_t n, rank_order_t order) {
+    int (*compare)(const void *, const void *) =
+        (order == RANK_COUNT) ? rank_compare_count : rank_compare_key;
+    rank_entry_t *tmp = (n > 1024) ? malloc(n * sizeof(rank_entry_t)) : NULL;
+    if(tmp == NULL) {
+        qsort(entries, n, sizeof(rank_entry_t), compare);
+        return;
+    }
+    int digits = (order == RANK_COUNT) ? RANK_DIGITS : 8;
+    size_t histogram[RANK_DIGITS][256];
+    memset(histogram, 0, sizeof(histogram));
+    for(size_t i = 0; i < n; i++) {
+        for(int d = 0; d < digits; d++)
+            histogram[d][rank_digit(&entries[i], d)]++;
+    }
+
+    rank_entry_t *from = entries, *to = tmp;
+    for(int d = 0; d < digits; d++) {
+        if(histogram[d][rank_digit(&entries[0], d)] == n) continue;
+        size_t offset = 0;
+        for(int b = 0; b < 256; b++) {
+            size_t count = histogram[d][b];
+            histogram[d][b] = offset;
+            offset += count;
+        }
+        for(size_t i = 0; i < n; i++)
+            to[histogram[d][rank_digit(&from[i], d)]++] = from[i];
+        rank_entry_t *swap = from;
+        from = to;
+        to = swap;
+    }
+    if(from != entries) memcpy(entries, from, n * sizeof(rank_entry_t));
+    free(tmp);
+
+    // runs with the same prefix (and count) are sorted by the whole keys
+    for(size_t i = 0; i < n; ) {
+        size_t j = i + 1;
+        while(j < n && entries[j].prefix == entries[i].prefix &&
+                (order == RANK_KEY || entries[j].count == entries[i].count))
+            j++;
+        if(j - i > 1) qsort(entries + i, j - i, sizeof(rank_entry_t), compare);
+        i = j;
+    }
+}
+
+rank_entry_t * rank_sorted(htable_t *htable, rank_order_t order) {
+    // malloc(0) could return NULL
+    rank_entry_t *entries = malloc((htable->count + 1) * sizeof(rank_entry_t));
+    if(entries == NULL) return NULL;
+
+    size_t n = 0;
+    for(htable_iterator_t it = htable_begin(htable); it.ptr != NULL;
+            it = htable_it_next(it)) {
+        entries[n++] = rank_entry(it.ptr);
+    }
+    rank_sort(entries, n, order);
+    return entries;
+}
+
+/* True if 'a' comes after 'b' in RANK_COUNT order. */
+static bool rank_after(const rank_entry_t *a, const rank_entry_t *b) {
+    return rank_compare_count(a, b) > 0;
+}
+
+/* Moves the entry at 'i' down the heap, which keeps the entry that comes
+ * last at the root. */
+static void rank_sift_down(rank_entry_t *heap, size_t n, size_t i) {
+    rank_entry_t entry = heap[i];
+    for(;;) {
+        size_t child = 2 * i + 1;
+        if(child >= n) break;
+        if(child + 1 < n && rank_after(&heap[child + 1], &heap[child]))
+            child++;
+        if(!rank_after(&heap[child], &entry)) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = entry;
+}
+
+static void rank_sift_up(rank_entry_t *heap, size_t i) {
+    rank_entry_t entry = heap[i];
+    while(i > 0) {
+        size_t parent = (i - 1) / 2;
+        if(!rank_after(&entry, &heap[parent])) break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = entry;
+}
+
+rank_entry_t * rank_top(htable_t *htable, size_t k, size_t *n) {
+    if(k > htable->count) k = htable->count;
+    rank_entry_t *heap = malloc((k + 1) * sizeof(rank_entry_t));
+    if(heap == NULL) return NULL;
+
+    *n = 0;
+    for(htable_iterator_t it = htable_begin(htable); it.ptr != NULL;
+            it = htable_it_next(it)) {
+        if(*n == k && k > 0 && it.ptr->data < heap[0].count) {
+            continue;  // the usual case, no need to look at the key
+        }
+        rank_entry_t entry = rank_entry(it.ptr);
+        if(*n < k) {
+            heap[*n] = entry;
+            rank_sift_up(heap, (*n)++);
+        }
+        else if(k > 0 && rank_after(&heap[0], &entry)) {
+            // better than the worst of the best 'k'
+            heap[0] = entry;
+            rank_sift_down(heap, k, 0);
+        }
+    }
+    rank_sort(heap, *n, RANK_COUNT);
+    return heap;
+}
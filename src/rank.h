@@ -0,0 +1,68 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Ordering the counted words of a hash table: all of them sorted, or only
+ * the most common ones.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __RANK_H__
+#define __RANK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "htable.h"
+
+
+typedef struct rank_entry           rank_entry_t;
+
+typedef enum rank_order {
+    RANK_COUNT,  // the highest count first, the same counts by key
+    RANK_KEY     // by key, byte by byte (like `LC_ALL=C sort`)
+} rank_order_t;
+
+/* One word of the table. The key points into the table, so the entries can
+ * only be used while the table exists. The first 8 bytes of the key are also
+ * kept in 'prefix', as a big endian number, so that most comparisons of keys
+ * don't have to go to the table's memory. */
+struct rank_entry {
+    uint64_t prefix;
+    const char *key;
+    unsigned int len;       // length of the key, it can contain '\0'
+    uint64_t count;
+};
+
+
+/**
+ * Sort all the words of the table.
+ * @return  Array of htable->count entries, which has to be freed, or NULL if
+ *          malloc failed.
+ */
+rank_entry_t * rank_sorted(htable_t *htable, rank_order_t order);
+
+/**
+ * Find the 'k' words with the highest counts, without sorting the whole
+ * table: the words are fed into a heap of the best 'k' seen so far, so only
+ * 'k' entries are ever allocated and most words take a single comparison.
+ * @param n  Set to the number of returned entries, at most 'k'.
+ * @return  Array of the entries in RANK_COUNT order, which has to be freed,
+ *          or NULL if malloc failed.
+ */
+rank_entry_t * rank_top(htable_t *htable, size_t k, size_t *n);
+
+/* Sort an array of entries. */
+void rank_sort(rank_entry_t *entries, size_t n, rank_order_t order);
+
+#endif /* __RANK_H__ */
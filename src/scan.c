@@ -0,0 +1,209 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+#include "scan.h"
+
+/*
+ * The vector versions classify 16 or 32 bytes at once: a byte is whitespace
+ * if it's equal to ' ', or if (byte - '\t') is at most 4 as an unsigned
+ * number (that covers '\t', '\n', '\v', '\f' and '\r'). The comparisons give
+ * a bit mask of the whitespace bytes, so the first one is found by counting
+ * the trailing zeros. The last few bytes, which don't fill a whole vector,
+ * are checked one by one, so that nothing after 'size' is ever read.
+ *
+ * Words are usually just a few characters long, so scanning from every word
+ * boundary would classify most bytes several times. scan_mask64() classifies
+ * 64 bytes into a mask that the caller can keep and search with bit
+ * operations until it gets past it (see tokenizer_next()).
+ *
+ * The implementation is chosen when the program starts (see scan_init()),
+ * according to what the CPU supports.
+ */
+
+typedef size_t (*scan_function_t)(const char *data, size_t pos, size_t size);
+typedef uint64_t (*scan_mask_function_t)(const char *p);
+
+static const bool scan_is_space[256] = {
+    ['\t'] = true, ['\n'] = true, ['\v'] = true, ['\f'] = true, ['\r'] = true,
+    [' '] = true,
+};
+
+static size_t scan_space_scalar(const char *data, size_t pos, size_t size) {
+    while(pos < size && !scan_is_space[(unsigned char)data[pos]])
+        pos++;
+    return pos;
+}
+
+static size_t scan_nonspace_scalar(const char *data, size_t pos,
+                                   size_t size) {
+    while(pos < size && scan_is_space[(unsigned char)data[pos]])
+        pos++;
+    return pos;
+}
+
+static uint64_t scan_mask64_scalar(const char *p) {
+    uint64_t mask = 0;
+    for(int i = 0; i < 64; i++)
+        mask |= (uint64_t)scan_is_space[(unsigned char)p[i]] << i;
+    return mask;
+}
+
+#ifdef SCAN_X86
+__attribute__((target("sse2")))
+static unsigned int scan_mask_sse2(const char *p) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    __m128i t = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(4)), t);
+    return (unsigned int)_mm_movemask_epi8(_mm_or_si128(space, control));
+}
+
+__attribute__((target("sse2")))
+static uint64_t scan_mask64_sse2(const char *p) {
+    return (uint64_t)scan_mask_sse2(p) |
+           (uint64_t)scan_mask_sse2(p + 16) << 16 |
+           (uint64_t)scan_mask_sse2(p + 32) << 32 |
+           (uint64_t)scan_mask_sse2(p + 48) << 48;
+}
+
+__attribute__((target("sse2")))
+static size_t scan_space_sse2(const char *data, size_t pos, size_t size) {
+    for( ; pos + 16 <= size; pos += 16) {
+        unsigned int mask = scan_mask_sse2(data + pos);
+        if(mask != 0)
+            return pos + __builtin_ctz(mask);
+    }
+    return scan_space_scalar(data, pos, size);
+}
+
+__attribute__((target("sse2")))
+static size_t scan_nonspace_sse2(const char *data, size_t pos, size_t size) {
+    for( ; pos + 16 <= size; pos += 16) {
+        unsigned int mask = ~scan_mask_sse2(data + pos) & 0xffff;
+        if(mask != 0)
+            return pos + __builtin_ctz(mask);
+    }
+    return scan_nonspace_scalar(data, pos, size);
+}
+
+__attribute__((target("avx2")))
+static unsigned int scan_mask_avx2(const char *p) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i control = _mm256_cmpeq_epi8(
+            _mm256_min_epu8(t, _mm256_set1_epi8(4)), t);
+    return (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(space,
+                                                              control));
+}
+
+__attribute__((target("avx2")))
+static uint64_t scan_mask64_avx2(const char *p) {
+    return (uint64_t)scan_mask_avx2(p) |
+           (uint64_t)scan_mask_avx2(p + 32) << 32;
+}
+
+__attribute__((target("avx2")))
+static size_t scan_space_avx2(const char *data, size_t pos, size_t size) {
+    for( ; pos + 32 <= size; pos += 32) {
+        unsigned int mask = scan_mask_avx2(data + pos);
+        if(mask != 0)
+            return pos + __builtin_ctz(mask);
+    }
+    return scan_space_sse2(data, pos, size);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_nonspace_avx2(const char *data, size_t pos, size_t size) {
+    for( ; pos + 32 <= size; pos += 32) {
+        unsigned int mask = ~scan_mask_avx2(data + pos);
+        if(mask != 0)
+            return pos + __builtin_ctz(mask);
+    }
+    return scan_nonspace_sse2(data, pos, size);
+}
+#endif
+
+static scan_impl_t scan_impl = SCAN_SCALAR;
+static scan_function_t scan_space_impl = scan_space_scalar;
+static scan_function_t scan_nonspace_impl = scan_nonspace_scalar;
+static scan_mask_function_t scan_mask64_impl = scan_mask64_scalar;
+
+uint64_t scan_mask64(const char *p) {
+    return scan_mask64_impl(p);
+}
+
+size_t scan_space(const char *data, size_t pos, size_t size) {
+    return scan_space_impl(data, pos, size);
+}
+
+size_t scan_nonspace(const char *data, size_t pos, size_t size) {
+    return scan_nonspace_impl(data, pos, size);
+}
+
+bool scan_select(scan_impl_t impl) {
+    switch(impl) {
+    case SCAN_SCALAR:
+        scan_space_impl = scan_space_scalar;
+        scan_nonspace_impl = scan_nonspace_scalar;
+        scan_mask64_impl = scan_mask64_scalar;
+        break;
+#ifdef SCAN_X86
+    case SCAN_SSE2:
+        if(!__builtin_cpu_supports("sse2"))
+            return false;
+        scan_space_impl = scan_space_sse2;
+        scan_nonspace_impl = scan_nonspace_sse2;
+        scan_mask64_impl = scan_mask64_sse2;
+        break;
+    case SCAN_AVX2:
+        if(!__builtin_cpu_supports("avx2"))
+            return false;
+        scan_space_impl = scan_space_avx2;
+        scan_nonspace_impl = scan_nonspace_avx2;
+        scan_mask64_impl = scan_mask64_avx2;
+        break;
+#endif
+    default:
+        return false;
+    }
+    scan_impl = impl;
+    return true;
+}
+
+scan_impl_t scan_selected(void) {
+    return scan_impl;
+}
+
+/* Choose the best implementation before main() starts, so that threads
+ * don't race for it. */
+__attribute__((constructor))
+static void scan_init(void) {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+#endif
+    if(!scan_select(SCAN_AVX2))
+        scan_select(SCAN_SSE2);
+}
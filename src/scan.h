@@ -0,0 +1,56 @@
+/* vim: tabstop=4 shiftwidth=4 expandtab
+ *
+ * Fast scanning of text for whitespace, using SSE2 or AVX2 if the CPU has
+ * them. Whitespace is what isspace() matches in the "C" locale: space, '\t',
+ * '\n', '\v', '\f' and '\r'.
+ *
+ * Copyright 2009 Martina Kollarova
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __SCAN_H__
+#define __SCAN_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef enum scan_impl {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+} scan_impl_t;
+
+
+/* Bit mask of the whitespace characters in the 64 bytes starting at 'p' (bit
+ * 0 is p[0]). All 64 bytes have to be readable. */
+uint64_t scan_mask64(const char *p);
+
+/* Offset of the first whitespace character in data[pos..size), or size. */
+size_t scan_space(const char *data, size_t pos, size_t size);
+
+/* Offset of the first other character in data[pos..size), or size. */
+size_t scan_nonspace(const char *data, size_t pos, size_t size);
+
+/**
+ * Choose the implementation, the best one the CPU supports is chosen at
+ * startup. Meant for benchmarks and tests.
+ * @return false if the CPU doesn't support it (nothing changes then).
+ */
+bool scan_select(scan_impl_t impl);
+
+/* The implementation in use. */
+scan_impl_t scan_selected(void);
+
+#endif /* __SCAN_H__ */
@@ -17,181 +17,835 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#define _GNU_SOURCE  // splice()
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <stdbool.h>
 #include <string.h>
-#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <limits.h>
 
 #include "debug.h"
+#include "out.h"
 
 #define PLUS 1
 #define MINUS 0
 
-// Simplified implementation - ignore the extra characters on a line longer
-// than this
-// 1024 characters + '\n' + '\0'
-#define MAX_LINE 1026
+#define FOLLOW_NONE 0
+#define FOLLOW_DESCRIPTOR 1  // -f, keep reading the opened file
+#define FOLLOW_NAME 2        // -F, reopen the file when it's replaced
+
+// size of the blocks read from the input
+#define TAIL_BLOCK (64 * 1024)
+
+// larger parts of regular files are copied by the kernel, see out_copy()
+#define ZERO_COPY_MIN (64 * 1024)
+// largest request to sendfile() or splice()
+#define ZERO_COPY_CHUNK (16 * 1024 * 1024)
 
 typedef struct params {
-    unsigned long lines;
-    bool plus_minus;  // which mode is used
-    char *filename;
+    unsigned long count;  // how many lines (or bytes) to print
+    bool plus_minus;      // which mode is used
+    bool bytes;           // -c, count bytes instead of lines
+    int follow;
+    char **files;
+    int file_count;
 } params_t;
 
+/* Ring buffer with the last lines (or bytes) of the input, see
+ * tail_minus(). Offsets are counted from the start of the input. */
+typedef struct line_ring {
+    char *data;
+    size_t capacity;           // power of two
+    size_t head;               // index of the byte at 'start' in data
+    uint64_t start, end;       // offsets of the bytes kept in data
+    uint64_t *newlines;        // offsets of the last newlines (also a ring)
+    size_t newlines_capacity;  // power of two
+    size_t newlines_first, newlines_count;
+    unsigned long int max_newlines;
+} line_ring_t;
+
+/* State of the follow mode. */
+typedef struct follow {
+    const char *filename;
+    const char *basename;  // name of the file in its directory
+    bool by_name;          // -F
+    int fd;                // followed file, -1 if it doesn't exist yet
+    int input_fd;          // of the FILE given to tail_follow(), which is
+                           // closed by the caller (-1 if none)
+    off_t pos;             // how much of the file was already printed
+    int notify;            // inotify instance
+    int file_watch;        // watch of the file (IN_MODIFY), -1 if none
+    int dir_watch;         // watch of the file's directory (-F only)
+    char *buffer;
+} follow_t;
+
+// standard output, everything printed goes through its buffer (see out.h)
+static out_t out;
+
 params_t get_params(int argc, char *argv[]);
 
+/* print the part of one input selected by the parameters */
+int tail_file(FILE *file, const params_t *params);
+
+/* print the "==> FILE <==" line that goes before each of more files */
+int print_header(const char *filename, bool first);
+
 /* print last X lines */
 int tail_minus(FILE *file, unsigned long int lines);
 
-/* print lines starting from line number X */
-void tail_plus(FILE *file, unsigned long int line);
+/* print last X lines of a regular file, reading it backwards from the end */
+int tail_minus_seek(FILE *file, unsigned long int lines);
+
+/* print last X bytes (-c) */
+int tail_bytes(FILE *file, unsigned long int bytes);
+
+/* the same for a regular file, without reading the rest of it */
+int tail_bytes_seek(FILE *file, unsigned long int bytes, bool plus_minus);
+
+/* true if the file can be read backwards by tail_minus_seek() */
+bool is_seekable(FILE *file);
+
+/* print the data appended to the file, until killed */
+int tail_follow(FILE *file, const char *filename, bool by_name);
 
-void free_2d_array(char **array[], int size);
+/* print lines (or bytes) starting from line number X */
+int tail_plus(FILE *file, unsigned long int line, bool bytes);
+
+/* copy a part of a regular file to the output */
+int out_copy(int fd, off_t start, off_t end);
+
+/* copy the rest of the input to the output */
+int out_copy_rest(int fd);
 
 void print_help();
 
 /*****************************************************************************/
 int main(int argc, char *argv[]) {
     params_t params = get_params(argc, argv);
-    FILE *input = NULL;
-    if(params.filename == NULL) input = stdin;
-    else {
-        input = fopen(params.filename, "r");
-        check(input, "Can't open file '%s'", params.filename);
+    bool failed = false;
+    bool first = true;  // no header was printed yet
+    // like tail(1), -0 prints nothing at all, not even the headers
+    bool headers = params.file_count > 1 &&
+        !(params.count == 0 && params.plus_minus == MINUS &&
+          params.follow == FOLLOW_NONE);
+    if(out_init(&out, STDOUT_FILENO, OUT_BUFFER) != 0) {
+        log_err("Out of memory.");
+        free(params.files);
+        return EXIT_FAILURE;
     }
-    if(params.plus_minus == MINUS) {
-        int res = tail_minus(input, params.lines);
-        if(res != 0) goto error;
+    if(params.file_count == 0) {
+        failed = tail_file(stdin, &params) != 0;
     }
-    else {
-        tail_plus(input, params.lines);
+    for(int i = 0; i < params.file_count; i++) {
+        const char *filename = params.files[i];
+        FILE *input = fopen(filename, "r");
+        if(input == NULL && params.follow == FOLLOW_NAME && errno == ENOENT) {
+            // -F waits for the file to be created
+            errno = 0;
+            log_info("'%s' doesn't exist yet, waiting for it", filename);
+            if(tail_follow(NULL, filename, true) != 0) failed = true;
+            continue;
+        }
+        if(input == NULL) {
+            log_err("Can't open file '%s'", filename);
+            errno = 0;
+            failed = true;
+            continue;
+        }
+        if(headers) {
+            if(print_header(filename, first) != 0) failed = true;
+            first = false;
+        }
+        if(tail_file(input, &params) != 0) {
+            failed = true;
+        }
+        else if(params.follow != FOLLOW_NONE) {
+            if(tail_follow(input, filename,
+                           params.follow == FOLLOW_NAME) != 0) {
+                failed = true;
+            }
+        }
+        fclose(input);
     }
-
-    fclose(input);
-    return 0;
-error:
-    if(input) fclose(input);
-    exit(EXIT_FAILURE);
+    if(out_flush(&out) != 0) {
+        log_err("Can't write the output");
+        failed = true;
+    }
+    out_free(&out);
+    free(params.files);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 /*****************************************************************************/
 
+/* Parses the number of lines or bytes, with an optional + or - before it. */
+static bool parse_count(const char *arg, params_t *result) {
+    result->plus_minus = (arg[0] == '+')? PLUS : MINUS;
+    if(arg[0] == '+' || arg[0] == '-') arg++;
+    // strtoul() would accept whitespace and another sign too
+    if(*arg < '0' || *arg > '9') return false;
+
+    char *end_p;
+    errno = 0;
+    result->count = strtoul(arg, &end_p, 10);
+    if(errno != 0 || *end_p != '\0') return false;
+
+    if(result->count == 0 && result->plus_minus == PLUS) {
+        result->count = 1;  // +0, special case, print everything
+    }
+    return true;
+}
+
 params_t get_params(int argc, char *argv[]) {
     params_t result = {
-        .lines = 10,
+        .count = 10,
         .plus_minus = MINUS,
-        .filename = NULL
+        .bytes = false,
+        .follow = FOLLOW_NONE,
+        .files = NULL,
+        .file_count = 0
     };
     // used to test if some parameter wasn't given twice
-    bool lines_set = false;
-    bool filename_set = false;
+    bool count_set = false;
+    bool follow_set = false;
+
+    result.files = malloc(argc * sizeof(char *));
+    check_mem(result.files);
 
     for(int i = 1; i < argc; i++) {
         if(strncmp(argv[i], "-h", 2) == 0) {
             print_help();
+            free(result.files);
             exit(EXIT_SUCCESS);
         }
+        else if(strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "-F") == 0) {
+            check(follow_set == false, "Too many parameters");
+            result.follow = (argv[i][1] == 'f')? FOLLOW_DESCRIPTOR
+                                               : FOLLOW_NAME;
+            follow_set = true;
+        }
+        else if(strncmp(argv[i], "-c", 2) == 0) {
+            check(count_set == false, "Too many parameters");
+            // -c N or -cN
+            const char *value = argv[i] + 2;
+            if(*value == '\0') {
+                check(i + 1 < argc, "Missing number of bytes after -c");
+                value = argv[++i];
+            }
+            check(parse_count(value, &result), "Invalid parameter %s", value);
+            result.bytes = true;
+            count_set = true;
+        }
         else if(argv[i][0] == '-' || argv[i][0] == '+' ) {
-            check(lines_set == false, "Too many parameters");
+            check(count_set == false, "Too many parameters");
             // --5 or --b is invalid
             check(argv[i][1] != '-', "Invalid parameter %s", argv[i]);
-
-            char *end_p;
-            result.lines = strtoul(argv[i] + 1, &end_p, 10);
-            check(errno == 0, "Invalid parameter %s", argv[i]);
-            if(end_p == argv[i] + 1 || *end_p != '\0') {
-                fail("Invalid parameter %s", argv[i]);
-            }
-            lines_set = true;
-            result.plus_minus = (argv[i][0] == '+')? PLUS : MINUS;
-
-            if(result.lines == 0) {
-                if(result.plus_minus == PLUS) {
-                    result.lines = 1;  // +0, special case, print all lines
-                }
-                else {
-                    exit(EXIT_SUCCESS);  // -0, don't print anything
-                }
-            }
+            check(parse_count(argv[i], &result), "Invalid parameter %s",
+                  argv[i]);
+            count_set = true;
         }
         else {
-            check(filename_set == false, "The FILE can be set only once");
-            result.filename = argv[i];
-            filename_set = true;
+            result.files[result.file_count++] = argv[i];
         }
     }
+    check(result.follow == FOLLOW_NONE || result.file_count > 0,
+          "Following needs a FILE");
+    check(result.follow == FOLLOW_NONE || result.file_count == 1,
+          "Only one FILE can be followed");
     return result;
 error:
+    free(result.files);
     print_help();
     exit(EXIT_FAILURE);
 }
 
+int tail_file(FILE *file, const params_t *params) {
+    bool seekable = is_seekable(file);
+    if(params->count == 0) {
+        // -0, don't print anything; with -f, only what's appended later
+        if(seekable) {
+            check(fseeko(file, 0, SEEK_END) == 0, "Can't seek in the file");
+        }
+        return 0;
+    }
+    if(params->bytes && seekable) {
+        return tail_bytes_seek(file, params->count, params->plus_minus);
+    }
+    if(params->plus_minus == PLUS) {
+        return tail_plus(file, params->count, params->bytes);
+    }
+    if(params->bytes) {
+        return tail_bytes(file, params->count);
+    }
+    return seekable ? tail_minus_seek(file, params->count)
+                    : tail_minus(file, params->count);
+error:
+    return -1;
+}
+
+int print_header(const char *filename, bool first) {
+    // the headers are separated by an empty line from the previous file
+    if(!first && out_write(&out, "\n", 1) != 0) return -1;
+    if(out_write(&out, "==> ", 4) != 0) return -1;
+    if(out_write(&out, filename, strlen(filename)) != 0) return -1;
+    return out_write(&out, " <==\n", 5);
+}
+
+static bool line_ring_init(line_ring_t *ring, unsigned long int lines) {
+    ring->capacity = TAIL_BLOCK;
+    ring->data = malloc(ring->capacity);
+    ring->head = 0;
+    ring->start = ring->end = 0;
+    // the newline before the first printed line is needed too
+    ring->max_newlines = (lines == ULONG_MAX) ? lines : lines + 1;
+    ring->newlines_capacity = 64;
+    ring->newlines = malloc(ring->newlines_capacity * sizeof(uint64_t));
+    ring->newlines_first = ring->newlines_count = 0;
+    return ring->data != NULL && ring->newlines != NULL;
+}
+
+static void line_ring_free(line_ring_t *ring) {
+    free(ring->data);
+    free(ring->newlines);
+    ring->data = NULL;
+    ring->newlines = NULL;
+}
+
+/* Copies the bytes from 'pos' to the end of the ring to 'dest'. */
+static void line_ring_copy(line_ring_t *ring, uint64_t pos, char *dest) {
+    size_t offset = (ring->head + (pos - ring->start)) & (ring->capacity - 1);
+    size_t len = ring->end - pos;
+    size_t first = (len < ring->capacity - offset) ? len
+                                                    : ring->capacity - offset;
+    memcpy(dest, ring->data + offset, first);
+    memcpy(dest + first, ring->data, len - first);
+}
+
+/* Prints the bytes from 'pos' to the end of the ring. */
+static int line_ring_write(line_ring_t *ring, uint64_t pos) {
+    size_t offset = (ring->head + (pos - ring->start)) & (ring->capacity - 1);
+    size_t len = ring->end - pos;
+    size_t first = (len < ring->capacity - offset) ? len
+                                                    : ring->capacity - offset;
+    if(out_write(&out, ring->data + offset, first) != 0) return -1;
+    return out_write(&out, ring->data, len - first);
+}
+
+/* Forgets the bytes before 'start'. */
+static void line_ring_drop(line_ring_t *ring, uint64_t start) {
+    ring->head = (ring->head + (start - ring->start)) & (ring->capacity - 1);
+    ring->start = start;
+}
+
+static bool line_ring_grow(line_ring_t *ring) {
+    char *data = malloc(2 * ring->capacity);
+    if(data == NULL) return false;
+    line_ring_copy(ring, ring->start, data);
+    free(ring->data);
+    ring->data = data;
+    ring->capacity *= 2;
+    ring->head = 0;
+    return true;
+}
+
+/* Remembers a newline at 'pos'. Once there are enough of them, the oldest
+ * one is forgotten, together with the bytes before it. */
+static bool line_ring_add_newline(line_ring_t *ring, uint64_t pos) {
+    size_t mask = ring->newlines_capacity - 1;
+    if(ring->newlines_count == ring->max_newlines) {
+        ring->newlines_first = (ring->newlines_first + 1) & mask;
+        ring->newlines_count--;
+    }
+    else if(ring->newlines_count == ring->newlines_capacity) {
+        uint64_t *newlines = malloc(2 * ring->newlines_capacity *
+                                    sizeof(uint64_t));
+        if(newlines == NULL) return false;
+        for(size_t i = 0; i < ring->newlines_count; i++)
+            newlines[i] = ring->newlines[(ring->newlines_first + i) & mask];
+        free(ring->newlines);
+        ring->newlines = newlines;
+        ring->newlines_capacity *= 2;
+        ring->newlines_first = 0;
+        mask = ring->newlines_capacity - 1;
+    }
+    ring->newlines[(ring->newlines_first + ring->newlines_count) & mask] = pos;
+    ring->newlines_count++;
+
+    if(ring->newlines_count == ring->max_newlines) {
+        line_ring_drop(ring, ring->newlines[ring->newlines_first] + 1);
+    }
+    return true;
+}
+
+/* Reads the next block of the input after the bytes in the ring, growing it
+ * when it's full. The number of bytes read is stored in 'got', 0 means the
+ * end of the input. Returns the new bytes, or NULL on error. */
+static const char * line_ring_read(line_ring_t *ring, FILE *file,
+                                   size_t *got) {
+    if(ring->end - ring->start == ring->capacity) {
+        check_mem(line_ring_grow(ring));
+    }
+    size_t used = ring->end - ring->start;
+    size_t offset = (ring->head + used) & (ring->capacity - 1);
+    size_t room = ring->capacity - used;
+    if(room > ring->capacity - offset) room = ring->capacity - offset;
+
+    *got = fread(ring->data + offset, 1, room, file);
+    check(*got > 0 || !ferror(file), "Can't read the input");
+    ring->end += *got;
+    return ring->data + offset;
+error:
+    return NULL;
+}
+
+/* Offset of the 'i'th remembered newline, counting from the newest one. */
+static uint64_t line_ring_newline(line_ring_t *ring, size_t i) {
+    size_t index = ring->newlines_first + ring->newlines_count - 1 - i;
+    return ring->newlines[index & (ring->newlines_capacity - 1)];
+}
+
+/* The input is read in blocks straight into a ring buffer of bytes, and the
+ * offsets of the newlines in it are kept in a second ring. When there are
+ * more newlines than needed to find the start of the last 'lines_requested'
+ * lines, the bytes before them are dropped, so the memory used is
+ * proportional to the length of the last lines (the buffer doubles when they
+ * don't fit), and there is no limit on the length of a line.
+ */
 int tail_minus (FILE * file, unsigned long int lines_requested) {
-    char s[MAX_LINE] = {'\0'};
-    unsigned long int lines_saved = 0;
-    char **line_buffer = (char **)calloc(lines_requested, sizeof(char *));
-    check_mem(line_buffer);
-
-    unsigned int i;
-    for(i = 0; fgets(s, MAX_LINE, file) != NULL;
-            i++, i = i % lines_requested) {
-        if(strlen(s) >= (MAX_LINE-1) && s[MAX_LINE-2] != '\n') {
-            fail("Line too long (longer lines not implemented)");
-        }
-
-        if(lines_requested > lines_saved) {
-            // create new line in buffer, since we still read less lines than
-            // we want to print
-            assert(i <= lines_requested);
-            line_buffer[i] = (char *)malloc(MAX_LINE * sizeof(char));
-            check_mem(line_buffer[i]);
-            strncpy(line_buffer[i], s, MAX_LINE);
-            lines_saved++;
-        }
-        else { // overwrite older line, since we won't need it
-            strncpy(line_buffer[i], s, MAX_LINE);
-        }
-    }
-    // print the buffered lines.
-    unsigned int j = 0;
-    for( ; j < lines_saved; i++, j++) {
-        i = i % lines_saved;
-        printf("%s", line_buffer[i]);
-    }
-    free_2d_array(&line_buffer, lines_requested);
+    line_ring_t ring;
+    check_mem(line_ring_init(&ring, lines_requested));
+
+    for(;;) {
+        size_t got;
+        const char *block = line_ring_read(&ring, file, &got);
+        if(block == NULL) goto error;
+        if(got == 0) break;
+
+        uint64_t block_start = ring.end - got;
+        const char *p = block;
+        while((p = memchr(p, '\n', got - (p - block))) != NULL) {
+            check_mem(line_ring_add_newline(&ring, block_start + (p - block)));
+            p++;
+        }
+    }
+    if(ring.end == ring.start) goto done;
+
+    // a last line without a newline at the end counts too
+    char last;
+    line_ring_copy(&ring, ring.end - 1, &last);
+    size_t needed = (last == '\n') ? lines_requested : lines_requested - 1;
+    uint64_t start = ring.start;
+    if(ring.newlines_count > needed) {
+        start = line_ring_newline(&ring, needed) + 1;
+    }
+
+    check(line_ring_write(&ring, start) == 0, "Can't write the output");
+done:
+    line_ring_free(&ring);
     return 0;
 error:
-    free_2d_array(&line_buffer, lines_requested);
+    line_ring_free(&ring);
     return -1;
 }
 
-void tail_plus(FILE *file, unsigned long int line) {
-    char s[MAX_LINE+1];
-    for(unsigned int i = 0; fgets(s, MAX_LINE, file) != NULL; i++) {
-        // print forever if necessary (if stdio doesn't end)
-        if(i >= line - 1) printf("%s", s);
+int tail_bytes(FILE *file, unsigned long int bytes) {
+    line_ring_t ring;
+    check_mem(line_ring_init(&ring, 0));
+
+    for(;;) {
+        size_t got;
+        const char *block = line_ring_read(&ring, file, &got);
+        if(block == NULL) goto error;
+        if(got == 0) break;
+
+        if(ring.end - ring.start > bytes) {
+            line_ring_drop(&ring, ring.end - bytes);
+        }
     }
+    check(line_ring_write(&ring, ring.start) == 0, "Can't write the output");
+    line_ring_free(&ring);
+    return 0;
+error:
+    line_ring_free(&ring);
+    return -1;
 }
 
-void free_2d_array(char **array_p[], int size) {
-    // assumes that the array is initialized with zeros
-    char **array = *array_p;
-    if(array == NULL) return;
-    for(int i = 0; i < size; i++) {
-        if(array[i]) free(array[i]);
-        array[i] = NULL;
+/* Only the printed bytes are read, so this doesn't depend on the size of
+ * the file. */
+int tail_bytes_seek(FILE *file, unsigned long int bytes, bool plus_minus) {
+    int fd = fileno(file);
+    struct stat st;
+    check(fstat(fd, &st) == 0, "Can't get the size of the file");
+    off_t begin = ftello(file);
+    check(begin != -1, "Can't get the position in the file");
+    off_t end = st.st_size;
+    if(begin > end) begin = end;
+    // follow mode continues from here
+    check(lseek(fd, end, SEEK_SET) != -1, "Can't seek in the file");
+
+    uint64_t available = end - begin;
+    off_t start;
+    if(plus_minus == MINUS) {
+        start = (available > bytes) ? end - (off_t)bytes : begin;
+    }
+    else {
+        start = (available > bytes - 1) ? begin + (off_t)(bytes - 1) : end;
+    }
+    return out_copy(fd, start, end);
+error:
+    return -1;
+}
+
+bool is_seekable(FILE *file) {
+    struct stat st;
+    if(fstat(fileno(file), &st) != 0) return false;
+    return S_ISREG(st.st_mode) && ftello(file) != -1;
+}
+
+/* Reads the file backwards in blocks of TAIL_BLOCK bytes, counting the
+ * newlines, until the start of the last 'lines_requested' lines is found.
+ * Only that part of the file is then read forward and written out, so the
+ * time doesn't depend on the size of the file. A file that doesn't end with
+ * a newline has one more line after the last newline, like in tail_minus().
+ */
+int tail_minus_seek(FILE *file, unsigned long int lines_requested) {
+    int fd = fileno(file);
+    char *block = malloc(TAIL_BLOCK);
+    check_mem(block);
+
+    struct stat st;
+    check(fstat(fd, &st) == 0, "Can't get the size of the file");
+    // when reading stdin, it might not be at the start of the file
+    off_t begin = ftello(file);
+    check(begin != -1, "Can't get the position in the file");
+    off_t end = st.st_size;
+    // follow mode continues from here
+    check(lseek(fd, end, SEEK_SET) != -1, "Can't seek in the file");
+
+    off_t start = begin;     // where the printed part starts
+    unsigned long int newlines = 0;
+    bool found = false;
+    for(off_t offset = end; offset > begin && !found; ) {
+        size_t len = (offset - begin > TAIL_BLOCK) ? TAIL_BLOCK
+                                                   : offset - begin;
+        offset -= len;
+        ssize_t got = pread(fd, block, len, offset);
+        check(got == (ssize_t)len, "Can't read the file");
+
+        for(size_t i = len; i-- > 0; ) {
+            if(block[i] != '\n') continue;
+            off_t pos = offset + i;
+            if(pos == end - 1) continue;  // the newline ending the last line
+            if(++newlines == lines_requested) {
+                start = pos + 1;
+                found = true;
+                break;
+            }
+        }
+    }
+    free(block);
+    return out_copy(fd, start, end);
+error:
+    free(block);
+    return -1;
+}
+
+/* The input is read in blocks straight into the output buffer and the lines
+ * before line X are skipped by counting the newlines with memchr(), without
+ * looking at the lines one by one. The rest of the block is kept in the
+ * buffer, and everything after it is handed over to out_copy_rest(), so the
+ * lines that are printed are never even scanned.
+ */
+int tail_plus(FILE *file, unsigned long int line, bool bytes) {
+    // stdio wasn't used to read this file yet, so nothing is buffered there
+    int fd = fileno(file);
+    unsigned long int skip = line - 1;  // lines (or bytes) left to skip
+    while(skip > 0) {
+        if(out.used == out.size) {
+            check(out_flush(&out) == 0, "Can't write the output");
+        }
+        char *block = out.buffer + out.used;
+        ssize_t got = read(fd, block, out.size - out.used);
+        if(got < 0 && errno == EINTR) continue;
+        check(got >= 0, "Can't read the input");
+        if(got == 0) return 0;  // fewer lines than X
+
+        const char *p = block;
+        if(bytes) {
+            p += ((size_t)got < skip) ? (size_t)got : skip;
+            skip -= p - block;
+        }
+        else {
+            const char *end = block + got;
+            while(skip > 0 && (p = memchr(p, '\n', end - p)) != NULL) {
+                p++;
+                skip--;
+            }
+            if(p == NULL) p = end;
+        }
+        // keep what's after the skipped part
+        size_t rest = got - (p - block);
+        memmove(block, p, rest);
+        out.used += rest;
+    }
+    return out_copy_rest(fd);
+error:
+    return -1;
+}
+
+/* Copies a part of a regular file through the output buffer. */
+static int out_copy_buffered(int fd, off_t start, off_t end) {
+    while(start < end) {
+        if(out.used == out.size) {
+            check(out_flush(&out) == 0, "Can't write the output");
+        }
+        size_t len = out.size - out.used;
+        if((off_t)len > end - start) len = end - start;
+        ssize_t got = pread(fd, out.buffer + out.used, len, start);
+        if(got < 0 && errno == EINTR) continue;
+        check(got > 0, "Can't read the file");
+        out.used += got;
+        start += got;
     }
-    free(array);
-    *array_p = NULL;
+    return 0;
+error:
+    return -1;
+}
+
+/* Small parts go through the output buffer, so that tail of many files ends
+ * up as a single write(). Larger ones are copied with sendfile(), which
+ * doesn't copy the data to user space and back. When sendfile() can't write
+ * to the output (e.g. a file opened for appending on older kernels), the
+ * buffer is used for the rest. */
+int out_copy(int fd, off_t start, off_t end) {
+    if(end - start < ZERO_COPY_MIN) return out_copy_buffered(fd, start, end);
+    check(out_flush(&out) == 0, "Can't write the output");
+    while(start < end) {
+        size_t len = (end - start > ZERO_COPY_CHUNK) ? ZERO_COPY_CHUNK
+                                                     : end - start;
+        ssize_t sent = sendfile(STDOUT_FILENO, fd, &start, len);
+        if(sent < 0 && errno == EINTR) continue;
+        if(sent < 0 && (errno == EINVAL || errno == ENOSYS)) {
+            errno = 0;
+            return out_copy_buffered(fd, start, end);
+        }
+        check(sent > 0, "Can't copy the file to the output");
+    }
+    return 0;
+error:
+    return -1;
+}
+
+/* Copies the input from its current position to its end, with sendfile()
+ * from a regular file or splice() from a pipe. Anything else, or an output
+ * the kernel can't copy into, goes through read() and write() of the whole
+ * output buffer. */
+int out_copy_rest(int fd) {
+    check(out_flush(&out) == 0, "Can't write the output");
+    struct stat st;
+    check(fstat(fd, &st) == 0, "Can't read the input");
+    bool zero_copy = S_ISREG(st.st_mode) || S_ISFIFO(st.st_mode);
+    for(;;) {
+        ssize_t got;
+        if(zero_copy) {
+            got = S_ISFIFO(st.st_mode)
+                ? splice(fd, NULL, STDOUT_FILENO, NULL, ZERO_COPY_CHUNK,
+                         SPLICE_F_MOVE | SPLICE_F_MORE)
+                : sendfile(STDOUT_FILENO, fd, NULL, ZERO_COPY_CHUNK);
+            if(got < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                errno = 0;
+                zero_copy = false;
+                continue;
+            }
+        }
+        else {
+            got = read(fd, out.buffer, out.size);
+            if(got > 0) {
+                check(out_write_all(STDOUT_FILENO, out.buffer, got) == 0,
+                      "Can't write the output");
+            }
+        }
+        if(got < 0 && errno == EINTR) continue;
+        check(got >= 0, "Can't copy the input to the output");
+        if(got == 0) return 0;
+    }
+error:
+    return -1;
+}
+
+/* Prints everything after f->pos. If the file got shorter than that, it
+ * was truncated and it's printed again from the start. */
+static int follow_copy(follow_t *f) {
+    struct stat st;
+    check(fstat(f->fd, &st) == 0, "Can't get the size of '%s'", f->filename);
+    if(st.st_size < f->pos) {
+        errno = 0;
+        log_info("'%s' was truncated", f->filename);
+        f->pos = 0;
+    }
+    while(f->pos < st.st_size) {
+        ssize_t got = pread(f->fd, f->buffer, TAIL_BLOCK, f->pos);
+        if(got < 0 && errno == EINTR) continue;
+        check(got >= 0, "Can't read '%s'", f->filename);
+        if(got == 0) break;  // truncated since fstat()
+        check(out_write_all(STDOUT_FILENO, f->buffer, got) == 0,
+              "Can't write the output");
+        f->pos += got;
+        // the file might still be growing, don't wait for the next event
+        if(f->pos >= st.st_size && got == TAIL_BLOCK) {
+            check(fstat(f->fd, &st) == 0, "Can't get the size of '%s'",
+                  f->filename);
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+/* Starts following the file that's currently under the name (-F). When the
+ * name doesn't exist, the old file stays open, since it may be still written
+ * to after a rotation. */
+static int follow_reopen(follow_t *f) {
+    int fd = open(f->filename, O_RDONLY | O_CLOEXEC);
+    if(fd == -1) {
+        errno = 0;
+        return 0;
+    }
+    struct stat st_new, st_old;
+    check(fstat(fd, &st_new) == 0, "Can't get the size of '%s'", f->filename);
+    if(f->fd != -1) {
+        check(fstat(f->fd, &st_old) == 0, "Can't get the size of '%s'",
+              f->filename);
+        if(st_old.st_dev == st_new.st_dev && st_old.st_ino == st_new.st_ino) {
+            close(fd);
+            return 0;
+        }
+        // finish the old file first
+        check(follow_copy(f) == 0, "Can't follow '%s'", f->filename);
+        if(f->fd != f->input_fd) close(f->fd);
+        errno = 0;
+        log_info("'%s' has been replaced, following the new file",
+                 f->filename);
+    }
+    else {
+        errno = 0;
+        log_info("'%s' has appeared, following it", f->filename);
+    }
+    if(f->file_watch != -1) inotify_rm_watch(f->notify, f->file_watch);
+    f->fd = fd;
+    f->pos = 0;
+    f->file_watch = inotify_add_watch(f->notify, f->filename, IN_MODIFY);
+    check(f->file_watch != -1, "Can't watch '%s'", f->filename);
+    return follow_copy(f);
+error:
+    if(fd != -1 && fd != f->fd) close(fd);
+    return -1;
+}
+
+/* Waits for inotify events and prints what was appended to the file after
+ * each of them. The kernel only wakes us up when the file was modified (or,
+ * with -F, when a file of the same name was created in its directory), and
+ * the new data is read in blocks of TAIL_BLOCK and written straight to the
+ * standard output, so an append usually costs one read of the event, one
+ * fstat, one pread and one write.
+ */
+int tail_follow(FILE *file, const char *filename, bool by_name) {
+    // the events carry the name of the file in the watched directory
+    char events[sizeof(struct inotify_event) + NAME_MAX + 1]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    char *dirname = NULL;
+    follow_t f = {
+        .filename = filename,
+        .by_name = by_name,
+        .fd = -1,
+        .input_fd = -1,
+        .file_watch = -1,
+        .dir_watch = -1,
+        .notify = -1,
+        .buffer = NULL
+    };
+    check(out_flush(&out) == 0, "Can't write the output");
+    if(file != NULL) {
+        struct stat st;
+        check(fstat(fileno(file), &st) == 0, "Can't get the size of '%s'",
+              filename);
+        if(!S_ISREG(st.st_mode)) return 0;  // the end of a pipe was reached
+        f.fd = f.input_fd = fileno(file);
+        f.pos = lseek(f.fd, 0, SEEK_CUR);
+        check(f.pos != -1, "Can't seek in '%s'", filename);
+    }
+    f.buffer = malloc(TAIL_BLOCK);
+    check_mem(f.buffer);
+    f.notify = inotify_init1(IN_CLOEXEC);
+    check(f.notify != -1, "Can't initialize inotify");
+    if(f.fd != -1) {
+        f.file_watch = inotify_add_watch(f.notify, filename, IN_MODIFY);
+        check(f.file_watch != -1, "Can't watch '%s'", filename);
+    }
+    if(by_name) {
+        const char *slash = strrchr(filename, '/');
+        f.basename = slash ? slash + 1 : filename;
+        dirname = slash ? strndup(filename, slash == filename ? 1
+                                                              : slash - filename)
+                        : strdup(".");
+        check_mem(dirname);
+        f.dir_watch = inotify_add_watch(f.notify, dirname,
+                                        IN_CREATE | IN_MOVED_TO);
+        check(f.dir_watch != -1, "Can't watch the directory '%s'", dirname);
+        // the file could have been created before the watch was added
+        check(follow_reopen(&f) == 0, "Can't follow '%s'", filename);
+    }
+    // anything appended since the first part was printed
+    if(f.fd != -1) check(follow_copy(&f) == 0, "Can't follow '%s'", filename);
+
+    for(;;) {
+        ssize_t len = read(f.notify, events, sizeof(events));
+        if(len < 0 && errno == EINTR) continue;
+        check(len > 0, "Can't read inotify events");
+
+        bool appeared = false;
+        for(char *p = events; p < events + len; ) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            if(event->wd == f.dir_watch && event->len > 0 &&
+                    strcmp(event->name, f.basename) == 0) {
+                appeared = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+        if(f.fd != -1) {
+            check(follow_copy(&f) == 0, "Can't follow '%s'", filename);
+        }
+        if(appeared) {
+            check(follow_reopen(&f) == 0, "Can't follow '%s'", filename);
+        }
+    }
+error:
+    if(f.notify != -1) close(f.notify);
+    if(f.fd != -1 && f.fd != f.input_fd) close(f.fd);
+    free(f.buffer);
+    free(dirname);
+    return -1;
 }
 
 void print_help() {
-    puts("Usage: tail [OPTIONS] [FILE]\n"
-         "Print the last 10 lines of FILE to standard output. "
+    puts("Usage: tail [OPTIONS] [FILE]...\n"
+         "Print the last 10 lines of each FILE to standard output, with a "
+         "header giving the file name when there are more of them. "
          "If no FILE is given, read standard input.\n"
          "-h\tshow usage information\n"
          "-X\toutput the last X lines\n"
          "+X\toutput all the lines starting from the Xth line "
-         "(`tail +1` will print everything)");
+         "(`tail +1` will print everything)\n"
+         "-c X\toutput the last X bytes\n"
+         "-c +X\toutput all the bytes starting from the Xth byte\n"
+         "-f\tafter printing, keep printing data appended to FILE\n"
+         "-F\tlike -f, but reopen FILE when it's replaced by a new file "
+         "(log rotation) and wait for it if it doesn't exist");
 }
@@ -14,51 +14,1039 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "htable.h"
+#include "htable_approx.h"
+#include "htable_hll.h"
+#include "htable_mapped.h"
 #include "io.h"
+#include "normalize.h"
+#include "out.h"
+#include "rank.h"
+#include "debug.h"
 
-/* The table needs to be large enough to distribute its items, ideally so that
- * a single index stores only one item. However, the larger the size, the
- * more memory it consumes. But since an empty item takes up only
- * sizeof(htable_list_t *), we don't need to be too strict about it.
+/* Initial size of the table. The table grows by itself when it gets too
+ * full, so this only needs to be large enough to avoid growing on small
+ * inputs. Since an empty item takes up only sizeof(htable_list_t), we don't
+ * need to be too strict about it.
  */
 #define HTABLE_SIZE 2000
 
-// Words longer than this on the input will be shortened to this size (and a
-// warning will be printed on stderr). Extra +1 for '\0'
-#define MAX_WORD_SIZE 100 + 1
+// upper limit for `-j`
+#define MAX_JOBS 1024
 
-int main() {
-    htable_t * htable;
-    htable = htable_init(HTABLE_SIZE);
-    char s[MAX_WORD_SIZE]  = {'\0'};
-    if(htable == NULL) {
-        perror("Hash table initialization failed");
-        return EXIT_FAILURE;
+// upper limit for `--approx`
+#define MAX_APPROX 100000000
+
+// number of words given to htable_lookup_batch() at once
+#define COUNT_BATCH 32
+// space for the copies of the words of a batch, when they come from a pipe
+#define COUNT_BATCH_BYTES 4096
+
+/* Numbers saved with the table of a checkpoint (see htable_save_user()): where
+ * the counting stopped, which file it was, and a hash of the bytes before the
+ * offset, to notice a file that was replaced or rewritten. */
+enum {
+    CHECKPOINT_OFFSET,
+    CHECKPOINT_DEVICE,
+    CHECKPOINT_INODE,
+    CHECKPOINT_TAIL,
+};
+#define CHECKPOINT_TAIL_SIZE 256
+
+typedef struct params {
+    htable_backend_t backend;
+    unsigned long jobs;
+    unsigned long top;   // --top K, 0 if not set
+    bool sorted;         // --sort was given
+    rank_order_t order;  // ... and its value
+    unsigned long approx;  // --approx N, 0 if not set
+    bool distinct;       // --distinct
+    char *save_sketch;   // --save-sketch FILE, NULL if not set
+    char **merge_sketches;  // every --merge-sketch FILE
+    int merge_count;
+    char *save_table;    // --save-table FILE, NULL if not set
+    char *table;         // --table FILE, NULL if not set
+    char *checkpoint;    // --checkpoint FILE, NULL if not set
+    bool stats;          // --stats
+    normalizer_t normalizer;  // --lower, --strip and --strip-punct
+    char *filename;
+} params_t;
+
+/* Part of the input counted by one thread. */
+typedef struct job {
+    pthread_t thread;
+    const char *data;
+    size_t size;
+    htable_backend_t backend;
+    htable_t *htable;
+    const normalizer_t *normalizer;
+    int error;      // errno, if the counting failed
+    bool stopped;   // the part has a word starting with '\0', see count_job()
+} job_t;
+
+params_t get_params(int argc, char *argv[]);
+
+/* Count the words from the tokenizer into the table, after normalizing them,
+ * return 0 or errno. */
+int count_words(htable_t *htable, tokenizer_t *tokenizer,
+                const normalizer_t *normalizer);
+
+/* Count the words of the file with 'params.jobs' threads. */
+htable_t * count_parallel(params_t params);
+
+/* Print the count and the word of every item of the table. */
+int print_table(htable_t *htable);
+
+/* Print the words in the order given by --top and --sort. */
+int print_ranked(htable_t *htable, params_t params);
+
+/* Count and print the most common words of the input approximately. */
+int count_approx(params_t params, FILE *input);
+
+/* Estimate and print the number of different words of the input. */
+int count_distinct(params_t params, FILE *input);
+
+/* Print the count of every word of the input in the saved table. */
+int lookup_table(params_t params, FILE *input);
+
+/* Count the words of the input after the offset saved in the checkpoint
+ * into the table, which gets the counts saved in the checkpoint first, and
+ * save a new checkpoint. */
+int count_checkpoint(htable_t *htable, params_t params, FILE *input);
+
+/* Print the statistics of the table (see htable_stats()) to stderr. */
+void print_stats(htable_t *htable);
+
+/* Write the table to 'params.save_table'. */
+int save_table(htable_t *htable, params_t params);
+
+void print_help();
+
+/*****************************************************************************/
+int main(int argc, char *argv[]) {
+    params_t params = get_params(argc, argv);
+    htable_t *htable = NULL;
+    FILE *input = NULL;
+
+    if(params.distinct) {
+        // with sketches to merge, the input is read only if there's a FILE
+        if(params.filename != NULL) {
+            input = fopen(params.filename, "r");
+            check(input, "Can't open file '%s'", params.filename);
+        }
+        else if(params.merge_count == 0) input = stdin;
+        int res = count_distinct(params, input);
+        if(input && input != stdin) fclose(input);
+        free(params.merge_sketches);
+        return (res == 0) ? 0 : EXIT_FAILURE;
+    }
+    if(params.approx > 0 || params.table != NULL) {
+        if(params.filename == NULL) input = stdin;
+        else {
+            input = fopen(params.filename, "r");
+            check(input, "Can't open file '%s'", params.filename);
+        }
+        int res = (params.table != NULL) ? lookup_table(params, input)
+                                         : count_approx(params, input);
+        if(input != stdin) fclose(input);
+        free(params.merge_sketches);
+        return (res == 0) ? 0 : EXIT_FAILURE;
+    }
+    if(params.jobs > 1) {
+        htable = count_parallel(params);
+        if(htable == NULL)
+            goto error;
+    }
+    else {
+        if(params.filename == NULL) input = stdin;
+        else {
+            input = fopen(params.filename, "r");
+            check(input, "Can't open file '%s'", params.filename);
+        }
+        htable = htable_init_backend(HTABLE_SIZE, params.backend);
+        if(htable == NULL) {
+            perror("Hash table initialization failed");
+            goto error;
+        }
+
+        if(params.checkpoint != NULL) {
+            check(count_checkpoint(htable, params, input) == 0,
+                  "Counting from the checkpoint failed");
+        }
+        else {
+            // read the words and look them up in the hash table
+            tokenizer_t tokenizer;
+            errno = tokenizer_open(&tokenizer, input);
+            check(errno == 0, "Can't read the input");
+            errno = count_words(htable, &tokenizer, &params.normalizer);
+            tokenizer_close(&tokenizer);
+            if(errno != 0) {
+                perror("List or list item initialization failed");
+                goto error;
+            }
+        }
+        if(input != stdin) fclose(input);
+        input = NULL;
+    }
+
+    if(params.save_table != NULL)
+        check(save_table(htable, params) == 0, "Saving the table failed");
+    if(params.stats)
+        print_stats(htable);
+
+    if(params.top > 0 || params.sorted) {
+        check(print_ranked(htable, params) == 0, "Sorting failed");
+    }
+    else {
+        check(print_table(htable) == 0, "Printing failed");
+    }
+
+    htable_free(&htable);
+    free(params.merge_sketches);
+    return 0;
+error:
+    if(htable) htable_free(&htable);
+    if(input && input != stdin) fclose(input);
+    free(params.merge_sketches);
+    return EXIT_FAILURE;
+}
+/*****************************************************************************/
+
+static int count_batch(htable_t *htable, const htable_str_t *words, size_t n) {
+    htable_listitem_t *items[COUNT_BATCH];
+    if(!htable_lookup_batch(htable, words, n, items))
+        return errno ? errno : ENOMEM;
+    return 0;
+}
+
+/* Look up a word that doesn't fit into the buffer of count_words(). */
+static int count_long_word(htable_t *htable, const char *word, size_t len,
+                           const normalizer_t *normalizer) {
+    char *copy = NULL;
+    size_t capacity = 0;
+    int error = 0;
+    word = normalize_copy(normalizer, word, &len, &copy, &capacity);
+    if(word == NULL)
+        error = ENOMEM;
+    else if(len > 0 && htable_lookup_len(htable, word, len) == NULL)
+        error = errno ? errno : ENOMEM;
+    free(copy);
+    return error;
+}
+
+int count_words(htable_t *htable, tokenizer_t *tokenizer,
+                const normalizer_t *normalizer) {
+    htable_str_t words[COUNT_BATCH];
+    char copies[COUNT_BATCH_BYTES];
+    size_t n = 0, used = 0;
+    // words read into the buffer are overwritten by the following blocks,
+    // and the normalization changes the words, so it needs a copy too
+    bool normalizing = normalize_enabled(normalizer);
+    bool copy = tokenizer->file != NULL || normalizing;
+    const char *word;
+    size_t len;
+    int error;
+    while((word = tokenizer_next(tokenizer, &len)) != NULL) {
+        if(copy) {
+            if(len > COUNT_BATCH_BYTES - used) {
+                if((error = count_batch(htable, words, n)) != 0)
+                    return error;
+                n = used = 0;
+            }
+            if(len > COUNT_BATCH_BYTES) {
+                if((error = count_long_word(htable, word, len,
+                                            normalizer)) != 0)
+                    return error;
+                continue;
+            }
+            char *copied = memcpy(copies + used, word, len);
+            if(normalizing) {
+                copied = normalize(normalizer, copied, &len);
+                if(len == 0)
+                    continue;
+            }
+            word = copied;
+            used = (copied - copies) + len;
+        }
+        words[n].str = word;
+        words[n].len = len;
+        if(++n == COUNT_BATCH) {
+            if((error = count_batch(htable, words, n)) != 0)
+                return error;
+            n = used = 0;
+        }
     }
+    if((error = count_batch(htable, words, n)) != 0)
+        return error;
+    return tokenizer->error;
+}
+
+static void * count_job(void *arg) {
+    job_t *job = arg;
+    job->htable = htable_init_backend(HTABLE_SIZE, job->backend);
+    if(job->htable == NULL) {
+        job->error = errno ? errno : ENOMEM;
+        return NULL;
+    }
+    tokenizer_t tokenizer;
+    tokenizer_init_memory(&tokenizer, job->data, job->size);
+    job->error = count_words(job->htable, &tokenizer, job->normalizer);
+    // the tokenizer stops before the end only at a word starting with '\0',
+    // which ends the whole input
+    job->stopped = tokenizer.pos < tokenizer.size;
+    return NULL;
+}
 
-    // read the words and look them up in the hash table
-    while(read_word(s, MAX_WORD_SIZE, stdin)) {
-        htable_listitem_t *res = htable_lookup(htable, s);
-        if(res == NULL) {
-            perror("List or list item initialization failed");
-            htable_free(&htable);
-            return EXIT_FAILURE;
+/* Count the whole input in this thread, for inputs that can't be mapped. */
+static htable_t * count_single(params_t params, FILE *file) {
+    tokenizer_t tokenizer;
+    htable_t *htable = htable_init_backend(HTABLE_SIZE, params.backend);
+    check_mem(htable);
+    errno = tokenizer_open(&tokenizer, file);
+    check(errno == 0, "Can't read the input");
+    errno = count_words(htable, &tokenizer, &params.normalizer);
+    tokenizer_close(&tokenizer);
+    check(errno == 0, "Counting failed");
+    return htable;
+error:
+    if(htable) htable_free(&htable);
+    return NULL;
+}
+
+/*
+ * The file is mapped into memory and split into 'params.jobs' parts of about
+ * the same size, each one ending right before a whitespace character, so that
+ * no word is split between two parts. Every part is counted into its own
+ * table by its own thread. The tables are then merged in the order of the
+ * parts, which gives the same table as counting the file in one thread (see
+ * htable_merge()), so the output is the same too. A word starting with '\0'
+ * ends the input, so the parts after the first one that has such a word are
+ * left out. Inputs that aren't regular files (pipes, /dev/stdin) can't be
+ * mapped, they are counted by a single thread.
+ */
+htable_t * count_parallel(params_t params) {
+    job_t *jobs = NULL;
+    unsigned long started = 0, joined = 0;
+    char *data = NULL;
+    size_t size = 0;
+    htable_t *result = NULL;
+    FILE *file = NULL;
+
+    file = fopen(params.filename, "r");
+    check(file, "Can't open file '%s'", params.filename);
+    struct stat st;
+    check(fstat(fileno(file), &st) == 0, "Can't stat '%s'", params.filename);
+    if(!S_ISREG(st.st_mode)) {
+        result = count_single(params, file);
+        fclose(file);
+        return result;
+    }
+    size = st.st_size;
+    if(size > 0) {
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if(data == MAP_FAILED) {
+            data = NULL;
+            fail("Can't map '%s'", params.filename);
         }
     }
 
-    // print the hash table
+    jobs = calloc(params.jobs, sizeof(job_t));
+    check_mem(jobs);
+    size_t from = 0;
+    for(unsigned long i = 0; i < params.jobs; i++) {
+        size_t to = (i == params.jobs - 1) ? size
+                                            : size / params.jobs * (i + 1);
+        if(to < from) to = from;
+        while(to < size && !isspace((unsigned char)data[to])) to++;
+
+        jobs[i].data = data + from;
+        jobs[i].size = to - from;
+        jobs[i].backend = params.backend;
+        jobs[i].normalizer = &params.normalizer;
+        from = to;
+        check(pthread_create(&jobs[i].thread, NULL, count_job, &jobs[i]) == 0,
+              "Can't create a thread");
+        started++;
+    }
+    for( ; joined < started; joined++)
+        pthread_join(jobs[joined].thread, NULL);
+    unsigned long counted = 0;  // the parts up to the first stopped one
+    while(counted < started && !jobs[counted++].stopped) {}
+    for(unsigned long i = 0; i < counted; i++) {
+        errno = jobs[i].error;
+        check(errno == 0, "Counting failed");
+    }
+
+    // the first table becomes the result
+    for(unsigned long i = 1; i < counted; i++) {
+        check(htable_merge(jobs[0].htable, jobs[i].htable), "Out of memory.");
+        htable_free(&jobs[i].htable);
+    }
+    result = jobs[0].htable;
+    jobs[0].htable = NULL;
+
+error:
+    if(jobs) {
+        // the threads started before a failure still use 'data'
+        for( ; joined < started; joined++)
+            pthread_join(jobs[joined].thread, NULL);
+        for(unsigned long i = 0; i < started; i++) {
+            if(jobs[i].htable) htable_free(&jobs[i].htable);
+        }
+        free(jobs);
+    }
+    if(data) munmap(data, size);
+    if(file) fclose(file);
+    return result;
+}
+
+/* Print one "COUNT WORD" line. */
+static int print_count(out_t *out, uint64_t count, const char *word,
+                       size_t len) {
+    if(out_uint(out, count) != 0 || out_char(out, ' ') != 0 ||
+            out_write(out, word, len) != 0)
+        return -1;
+    return out_char(out, '\n');
+}
+
+int print_table(htable_t *htable) {
+    out_t out = {.buffer = NULL};
+    check(out_init(&out, STDOUT_FILENO, OUT_BUFFER) == 0, "Out of memory.");
     for(htable_iterator_t iterator = htable_begin(htable);
             iterator.ptr != NULL;
             iterator = htable_it_next(iterator)) {
+        check(print_count(&out, iterator.ptr->data, iterator.ptr->key,
+                          iterator.ptr->len) == 0,
+              "Can't write the output");
+    }
+    check(out_flush(&out) == 0, "Can't write the output");
+    out_free(&out);
+    return 0;
+error:
+    out_free(&out);
+    return -1;
+}
 
-        printf("%d %s\n", iterator.ptr->data, iterator.ptr->key);
+int print_ranked(htable_t *htable, params_t params) {
+    out_t out = {.buffer = NULL};
+    rank_entry_t *entries;
+    size_t n = htable->count;
+    if(params.top > 0) {
+        entries = rank_top(htable, params.top, &n);
+        check_mem(entries);
+        // the best K, shown by key
+        if(params.sorted && params.order == RANK_KEY)
+            rank_sort(entries, n, RANK_KEY);
     }
+    else {
+        entries = rank_sorted(htable, params.order);
+        check_mem(entries);
+    }
+    check(out_init(&out, STDOUT_FILENO, OUT_BUFFER) == 0, "Out of memory.");
+    for(size_t i = 0; i < n; i++) {
+        check(print_count(&out, entries[i].count, entries[i].key,
+                          entries[i].len) == 0,
+              "Can't write the output");
+    }
+    check(out_flush(&out) == 0, "Can't write the output");
+    out_free(&out);
+    free(entries);
+    return 0;
+error:
+    out_free(&out);
+    free(entries);
+    return -1;
+}
 
-    htable_free(&htable);
+/*
+ * Only the 'params.approx' most common words are tracked, in a table of a
+ * fixed size (see htable_approx_add()), so the memory doesn't grow with the
+ * input. Every word is printed with the most its count can be too high by.
+ */
+int count_approx(params_t params, FILE *input) {
+    out_t out = {.buffer = NULL};
+    char *copy = NULL;
+    size_t capacity = 0;
+    htable_approx_item_t **items = NULL;
+    htable_approx_t *htable = htable_approx_init(params.approx);
+    check_mem(htable);
+
+    tokenizer_t tokenizer;
+    errno = tokenizer_open(&tokenizer, input);
+    check(errno == 0, "Can't read the input");
+    const char *word;
+    size_t len;
+    while((word = tokenizer_next(&tokenizer, &len)) != NULL) {
+        word = normalize_copy(&params.normalizer, word, &len, &copy,
+                              &capacity);
+        if(word == NULL ||
+                (len > 0 && htable_approx_add(htable, word, len) == NULL)) {
+            tokenizer_close(&tokenizer);
+            fail("Out of memory.");
+        }
+    }
+    errno = tokenizer.error;
+    tokenizer_close(&tokenizer);
+    check(errno == 0, "Can't read the input");
+
+    size_t n;
+    items = htable_approx_sorted(htable, &n);
+    check_mem(items);
+    if(params.top > 0 && params.top < n) n = params.top;
+    check(out_init(&out, STDOUT_FILENO, OUT_BUFFER) == 0, "Out of memory.");
+    for(size_t i = 0; i < n; i++) {
+        // COUNT WORD ERROR
+        check(out_uint(&out, items[i]->count) == 0 &&
+              out_char(&out, ' ') == 0 &&
+              out_write(&out, items[i]->key, items[i]->len) == 0 &&
+              out_char(&out, ' ') == 0 &&
+              out_uint(&out, items[i]->error) == 0 &&
+              out_char(&out, '\n') == 0, "Can't write the output");
+    }
+    check(out_flush(&out) == 0, "Can't write the output");
+
+    out_free(&out);
+    free(copy);
+    free(items);
+    htable_approx_free(&htable);
+    return 0;
+error:
+    out_free(&out);
+    free(copy);
+    free(items);
+    if(htable) htable_approx_free(&htable);
+    return -1;
+}
+
+/*
+ * The table is mapped into memory (see htable_open_mapped()), so it can be
+ * queried right away, however large it is.
+ */
+int lookup_table(params_t params, FILE *input) {
+    out_t out = {.buffer = NULL};
+    char *copy = NULL;
+    size_t capacity = 0;
+    htable_mapped_t *mapped = htable_open_mapped(params.table);
+    check(mapped, "Can't open table '%s'", params.table);
+    check(out_init(&out, STDOUT_FILENO, OUT_BUFFER) == 0, "Out of memory.");
+
+    tokenizer_t tokenizer;
+    errno = tokenizer_open(&tokenizer, input);
+    check(errno == 0, "Can't read the input");
+    const char *word;
+    size_t len;
+    while((word = tokenizer_next(&tokenizer, &len)) != NULL) {
+        word = normalize_copy(&params.normalizer, word, &len, &copy,
+                              &capacity);
+        if(word == NULL) {
+            tokenizer_close(&tokenizer);
+            fail("Out of memory.");
+        }
+        if(len == 0)
+            continue;
+        const htable_mapped_item_t *item =
+            htable_mapped_find(mapped, word, len);
+        if(print_count(&out, item ? item->data : 0, word, len) != 0) {
+            tokenizer_close(&tokenizer);
+            fail("Can't write the output");
+        }
+    }
+    errno = tokenizer.error;
+    tokenizer_close(&tokenizer);
+    check(errno == 0, "Can't read the input");
+    check(out_flush(&out) == 0, "Can't write the output");
+    out_free(&out);
+    free(copy);
+    htable_mapped_close(&mapped);
+    return 0;
+error:
+    out_free(&out);
+    free(copy);
+    if(mapped) htable_mapped_close(&mapped);
+    return -1;
+}
+
+/* Hash of the CHECKPOINT_TAIL_SIZE bytes of the file before 'offset', or of
+ * all the bytes before it if there are fewer. */
+static bool checkpoint_tail(int fd, uint64_t offset, uint64_t *hash) {
+    char buffer[CHECKPOINT_TAIL_SIZE];
+    size_t size = offset < CHECKPOINT_TAIL_SIZE ? offset
+                                                : CHECKPOINT_TAIL_SIZE;
+    if(pread(fd, buffer, size, offset - size) != (ssize_t)size)
+        return false;
+    *hash = htable_hash_wyhash(buffer, size);
+    return true;
+}
+
+/* Fill the table with the counts of the checkpoint and return its offset, or
+ * 0 if there's no checkpoint or the input isn't the one it was made from. */
+static int checkpoint_load(htable_t *htable, params_t params, int fd,
+                           const struct stat *st, uint64_t *offset) {
+    *offset = 0;
+    htable_mapped_t *mapped = htable_open_mapped(params.checkpoint);
+    if(mapped == NULL) {
+        check(errno == ENOENT, "Can't open checkpoint '%s'",
+              params.checkpoint);
+        return 0;
+    }
+    uint64_t tail;
+    const uint64_t *user = mapped->user;
+    if(user[CHECKPOINT_DEVICE] != (uint64_t)st->st_dev ||
+            user[CHECKPOINT_INODE] != (uint64_t)st->st_ino ||
+            user[CHECKPOINT_OFFSET] > (uint64_t)st->st_size ||
+            !checkpoint_tail(fd, user[CHECKPOINT_OFFSET], &tail) ||
+            tail != user[CHECKPOINT_TAIL]) {
+        errno = 0;
+        log_info("'%s' changed since the checkpoint, counting all of it",
+                 params.filename);
+        htable_mapped_close(&mapped);
+        return 0;
+    }
+    for(uint64_t i = 0; i < mapped->count; i++) {
+        const htable_mapped_item_t *item = &mapped->items[i];
+        const char *key = htable_mapped_key(mapped, item);
+        check(key, "Checkpoint '%s' is corrupted", params.checkpoint);
+        htable_listitem_t *listitem = htable_lookup_len(htable, key,
+                                                        item->len);
+        check_mem(listitem);
+        listitem->data = item->data;
+    }
+    *offset = user[CHECKPOINT_OFFSET];
+    htable_mapped_close(&mapped);
+    return 0;
+error:
+    if(mapped) htable_mapped_close(&mapped);
+    return -1;
+}
+
+/* Write the checkpoint next to its final name and rename it, so that an
+ * interrupted run leaves the previous checkpoint intact. */
+static int checkpoint_save(htable_t *htable, params_t params, int fd,
+                           const struct stat *st, uint64_t offset) {
+    FILE *file = NULL;
+    uint64_t user[HTABLE_MAPPED_USER] = {0};
+    user[CHECKPOINT_OFFSET] = offset;
+    user[CHECKPOINT_DEVICE] = st->st_dev;
+    user[CHECKPOINT_INODE] = st->st_ino;
+    char *temporary = malloc(strlen(params.checkpoint) + sizeof(".tmp"));
+    check_mem(temporary);
+    sprintf(temporary, "%s.tmp", params.checkpoint);
+
+    check(checkpoint_tail(fd, offset, &user[CHECKPOINT_TAIL]),
+          "Can't read '%s'", params.filename);
+    file = fopen(temporary, "wb");
+    check(file, "Can't create checkpoint '%s'", temporary);
+    if(!htable_save_user(htable, file, user)) {
+        fclose(file);
+        fail("Can't write checkpoint '%s'", temporary);
+    }
+    check(fclose(file) == 0, "Can't write checkpoint '%s'", temporary);
+    check(rename(temporary, params.checkpoint) == 0,
+          "Can't replace checkpoint '%s'", params.checkpoint);
+    free(temporary);
+    return 0;
+error:
+    if(temporary) remove(temporary);
+    free(temporary);
+    return -1;
+}
+
+/*
+ * The checkpoint is a table saved by htable_save_user() with the offset in
+ * the input where the counting stopped, so a file that only grows is counted
+ * in time proportional to what was appended since the last run. A word at
+ * the very end of the input, without whitespace after it, may still be
+ * written to; it's counted and printed, but the next checkpoint starts before
+ * it, so that it's counted again, whole, next time.
+ */
+int count_checkpoint(htable_t *htable, params_t params, FILE *input) {
+    char *copy = NULL;
+    size_t capacity = 0;
+    tokenizer_t tokenizer;
+    tokenizer_init_memory(&tokenizer, NULL, 0);
+    int fd = fileno(input);
+    struct stat st;
+    check(fstat(fd, &st) == 0 && S_ISREG(st.st_mode),
+          "Parameter --checkpoint needs a regular FILE");
+    uint64_t offset;
+    check(checkpoint_load(htable, params, fd, &st, &offset) == 0,
+          "Can't load checkpoint '%s'", params.checkpoint);
+
+    check(fseeko(input, offset, SEEK_SET) == 0, "Can't seek in '%s'",
+          params.filename);
+    errno = tokenizer_open(&tokenizer, input);
+    check(errno == 0, "Can't read the input");
+    const char *word, *unfinished = NULL;
+    size_t len;
+    while((word = tokenizer_next(&tokenizer, &len)) != NULL) {
+        if(tokenizer.pos == tokenizer.size) {
+            unfinished = word;
+            break;
+        }
+        word = normalize_copy(&params.normalizer, word, &len, &copy,
+                              &capacity);
+        check_mem(word);
+        if(len > 0 && htable_lookup_len(htable, word, len) == NULL) {
+            errno = errno ? errno : ENOMEM;
+            fail("Out of memory.");
+        }
+    }
+    errno = tokenizer.error;
+    check(errno == 0, "Can't read the input");
+
+    // a regular file is mapped whole, so positions in it are file offsets
+    if(unfinished != NULL)
+        offset = unfinished - tokenizer.data;
+    else if(tokenizer.size > offset)
+        offset = tokenizer.size;
+    check(checkpoint_save(htable, params, fd, &st, offset) == 0,
+          "Can't save checkpoint '%s'", params.checkpoint);
+    if(unfinished != NULL) {
+        word = normalize_copy(&params.normalizer, unfinished, &len, &copy,
+                              &capacity);
+        check_mem(word);
+        if(len > 0)
+            check_mem(htable_lookup_len(htable, word, len));
+    }
+    tokenizer_close(&tokenizer);
+    free(copy);
+    return 0;
+error:
+    tokenizer_close(&tokenizer);
+    free(copy);
+    return -1;
+}
+
+void print_stats(htable_t *htable) {
+    htable_stats_t stats;
+    htable_stats(htable, &stats);
+    bool chained = stats.backend == HTABLE_CHAINED;
+    fprintf(stderr, "keys: %lu\n", stats.count);
+    fprintf(stderr, "%s: %u\n", chained ? "lists" : "slots", stats.size);
+    fprintf(stderr, "load factor: %.3f\n", stats.load_factor);
+    // how many lists have each length, or how many keys are that many
+    // groups away from where their search starts
+    fprintf(stderr, "%s:", chained ? "list lengths" : "probe distances");
+    for(int i = 0; i < HTABLE_STATS_LENGTHS; i++) {
+        fprintf(stderr, " %d%s=%lu", i,
+                i == HTABLE_STATS_LENGTHS - 1 ? "+" : "", stats.lengths[i]);
+    }
+    fprintf(stderr, "\n%s: %lu\n", chained ? "longest list" :
+                                              "longest probe distance",
+            stats.max_length);
+    if(stats.probes_counted) {
+        fprintf(stderr, "lookups: %lu\n", stats.lookups);
+        fprintf(stderr, "%s compared per lookup: %.3f average, %lu max\n",
+                chained ? "keys" : "groups", stats.average_probes,
+                stats.max_probes);
+    }
+    fprintf(stderr, "memory: %zu B %s, %zu B items, %zu B keys\n",
+            stats.table_bytes, chained ? "lists" : "slots", stats.item_bytes,
+            stats.key_bytes);
+}
+
+int save_table(htable_t *htable, params_t params) {
+    FILE *file = fopen(params.save_table, "wb");
+    check(file, "Can't create table '%s'", params.save_table);
+    if(!htable_save(htable, file)) {
+        fclose(file);
+        fail("Can't write table '%s'", params.save_table);
+    }
+    check(fclose(file) == 0, "Can't write table '%s'", params.save_table);
+    return 0;
+error:
+    return -1;
+}
+
+/*
+ * The words go into a HyperLogLog sketch of a few KB (see htable_hll.h), so
+ * the memory doesn't grow with the number of different words. The sketches of
+ * earlier runs are merged into it, and it can be saved to be merged later.
+ */
+int count_distinct(params_t params, FILE *input) {
+    FILE *file = NULL;
+    htable_hll_t *other = NULL;
+    htable_hll_t *hll = htable_hll_init(HTABLE_HLL_PRECISION);
+    check_mem(hll);
+
+    if(input != NULL) {
+        tokenizer_t tokenizer;
+        errno = tokenizer_open(&tokenizer, input);
+        check(errno == 0, "Can't read the input");
+        const char *word;
+        size_t len;
+        char *copy = NULL;
+        size_t capacity = 0;
+        while((word = tokenizer_next(&tokenizer, &len)) != NULL) {
+            word = normalize_copy(&params.normalizer, word, &len, &copy,
+                                  &capacity);
+            if(word == NULL) {
+                tokenizer.error = ENOMEM;
+                break;
+            }
+            if(len > 0)
+                htable_hll_add(hll, word, len);
+        }
+        free(copy);
+        errno = tokenizer.error;
+        tokenizer_close(&tokenizer);
+        check(errno == 0, "Can't read the input");
+    }
+
+    for(int i = 0; i < params.merge_count; i++) {
+        const char *name = params.merge_sketches[i];
+        file = fopen(name, "rb");
+        check(file, "Can't open sketch '%s'", name);
+        other = htable_hll_load(file);
+        check(other, "Can't load sketch '%s'", name);
+        fclose(file);
+        file = NULL;
+        check(htable_hll_merge(hll, other),
+              "Sketch '%s' has a different precision", name);
+        htable_hll_free(&other);
+    }
+
+    if(params.save_sketch != NULL) {
+        file = fopen(params.save_sketch, "wb");
+        check(file, "Can't create sketch '%s'", params.save_sketch);
+        check(htable_hll_save(hll, file) && fclose(file) == 0,
+              "Can't write sketch '%s'", params.save_sketch);
+        file = NULL;
+    }
+
+    printf("%.0f\n", htable_hll_estimate(hll));
+    htable_hll_free(&hll);
     return 0;
+error:
+    if(file) fclose(file);
+    if(other) htable_hll_free(&other);
+    if(hll) htable_hll_free(&hll);
+    return -1;
+}
+/*****************************************************************************/
+
+params_t get_params(int argc, char *argv[]) {
+    params_t result = {
+        .backend = HTABLE_CHAINED,
+        .jobs = 1,
+        .top = 0,
+        .sorted = false,
+        .order = RANK_COUNT,
+        .approx = 0,
+        .distinct = false,
+        .save_sketch = NULL,
+        .merge_sketches = NULL,
+        .merge_count = 0,
+        .save_table = NULL,
+        .table = NULL,
+        .checkpoint = NULL,
+        .stats = false,
+        .filename = NULL,
+    };
+    bool filename_set = false;
+    bool lower = false;
+    const char *strip = NULL;
+    result.merge_sketches = malloc(argc * sizeof(char *));
+    check_mem(result.merge_sketches);
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-h") == 0) {
+            print_help();
+            exit(EXIT_SUCCESS);
+        }
+        else if(strcmp(argv[i], "--backend") == 0) {
+            check(i + 1 < argc, "Missing value of %s", argv[i]);
+            i++;
+            if(strcmp(argv[i], "chained") == 0)
+                result.backend = HTABLE_CHAINED;
+            else if(strcmp(argv[i], "swiss") == 0)
+                result.backend = HTABLE_SWISS;
+            else
+                fail("Invalid backend %s", argv[i]);
+        }
+        else if(strncmp(argv[i], "-j", 2) == 0) {
+            // both `-j 4` and `-j4` work
+            const char *value = argv[i] + 2;
+            if(*value == '\0') {
+                check(i + 1 < argc, "Missing value of %s", argv[i]);
+                value = argv[++i];
+            }
+            char *end_p;
+            errno = 0;
+            result.jobs = strtoul(value, &end_p, 10);
+            check(errno == 0 && end_p != value && *end_p == '\0' &&
+                  result.jobs >= 1 && result.jobs <= MAX_JOBS,
+                  "Invalid number of jobs %s", value);
+        }
+        else if(strcmp(argv[i], "--top") == 0) {
+            check(i + 1 < argc, "Missing value of %s", argv[i]);
+            i++;
+            char *end_p;
+            errno = 0;
+            result.top = strtoul(argv[i], &end_p, 10);
+            check(errno == 0 && end_p != argv[i] && *end_p == '\0' &&
+                  argv[i][0] != '-' && result.top >= 1,
+                  "Invalid number of words %s", argv[i]);
+        }
+        else if(strcmp(argv[i], "--approx") == 0) {
+            check(i + 1 < argc, "Missing value of %s", argv[i]);
+            i++;
+            char *end_p;
+            errno = 0;
+            result.approx = strtoul(argv[i], &end_p, 10);
+            check(errno == 0 && end_p != argv[i] && *end_p == '\0' &&
+                  argv[i][0] != '-' && result.approx >= 1 &&
+                  result.approx <= MAX_APPROX,
+                  "Invalid number of words %s", argv[i]);
+        }
+        else if(strcmp(argv[i], "--distinct") == 0) {
+            result.distinct = true;
+        }
+        else if(strcmp(argv[i], "--save-sketch") == 0) {
+            check(i + 1 < argc, "Missing value of %s", argv[i]);
+            result.save_sketch = argv[++i];
+        }
+        else if(strcmp(argv[i], "--merge-sketch") == 0) {
+            check(i + 1 < argc, "Missing value of %s", argv[i]);
+            result.merge_sketches[result.merge_count++] = argv[++i];
+        }
+        else if(strcmp(argv[i], "--save-table") == 0) {
+            check(i + 1 < argc, "Missing value of %s", argv[i]);
+            result.save_table = argv[++i];
+        }
+        else if(strcmp(argv[i], "--table") == 0) {
+            check(i + 1 < argc, "Missing value of %s", argv[i]);
+            result.table = argv[++i];
+        }
+        else if(strcmp(argv[i], "--stats") == 0) {
+            result.stats = true;
+        }
+        else if(strcmp(argv[i], "--lower") == 0) {
+            lower = true;
+        }
+        else if(strcmp(argv[i], "--strip") == 0) {
+            check(i + 1 < argc, "Missing value of %s", argv[i]);
+            strip = argv[++i];
+        }
+        else if(strcmp(argv[i], "--strip-punct") == 0) {
+            strip = NORMALIZE_PUNCT;
+        }
+        else if(strcmp(argv[i], "--checkpoint") == 0) {
+            check(i + 1 < argc, "Missing value of %s", argv[i]);
+            result.checkpoint = argv[++i];
+        }
+        else if(strcmp(argv[i], "--sort") == 0) {
+            check(i + 1 < argc, "Missing value of %s", argv[i]);
+            i++;
+            if(strcmp(argv[i], "count") == 0)
+                result.order = RANK_COUNT;
+            else if(strcmp(argv[i], "key") == 0)
+                result.order = RANK_KEY;
+            else
+                fail("Invalid sort order %s", argv[i]);
+            result.sorted = true;
+        }
+        else if(argv[i][0] == '-' && argv[i][1] != '\0') {
+            fail("Invalid parameter %s", argv[i]);
+        }
+        else {
+            check(filename_set == false, "The FILE can be set only once");
+            result.filename = argv[i];
+            filename_set = true;
+        }
+    }
+    check(result.jobs == 1 || result.filename != NULL,
+          "Parameter -j needs a FILE");
+    check(result.approx == 0 || result.jobs == 1,
+          "Parameter --approx can't be used with -j");
+    check(result.approx == 0 || !result.sorted || result.order == RANK_COUNT,
+          "Parameter --approx can only sort by count");
+    check(result.distinct || (result.save_sketch == NULL &&
+                              result.merge_count == 0),
+          "Sketches can only be used with --distinct");
+    check(!result.distinct || (result.jobs == 1 && result.approx == 0 &&
+                               result.top == 0 && !result.sorted),
+          "Parameter --distinct can't be used with -j, --approx, --top "
+          "or --sort");
+    check(result.table == NULL || (!result.distinct && result.approx == 0 &&
+                                   result.jobs == 1 && result.top == 0 &&
+                                   !result.sorted &&
+                                   result.save_table == NULL),
+          "Parameter --table can't be used with other options");
+    check(result.save_table == NULL || (!result.distinct &&
+                                        result.approx == 0),
+          "Parameter --save-table can't be used with --distinct or "
+          "--approx");
+    check(result.checkpoint == NULL || result.filename != NULL,
+          "Parameter --checkpoint needs a FILE");
+    check(result.checkpoint == NULL || (result.jobs == 1 &&
+                                        !result.distinct &&
+                                        result.approx == 0 &&
+                                        result.table == NULL),
+          "Parameter --checkpoint can't be used with -j, --distinct, "
+          "--approx or --table");
+    check(!result.stats || (!result.distinct && result.approx == 0 &&
+                            result.table == NULL),
+          "Parameter --stats can't be used with --distinct, --approx or "
+          "--table");
+    check(normalizer_init(&result.normalizer, lower, strip),
+          "Invalid characters to strip, they have to be UTF-8 with at most "
+          "%d that aren't ASCII", NORMALIZE_WIDE);
+    return result;
+error:
+    free(result.merge_sketches);
+    print_help();
+    exit(EXIT_FAILURE);
+}
+
+void print_help() {
+    puts("Usage: wordcount [OPTIONS] [FILE]\n"
+         "Count the occurrences of each word in FILE. "
+         "If no FILE is given, read standard input.\n"
+         "-h\t\t\tshow usage information\n"
+         "-j N\t\t\tcount the FILE with N threads\n"
+         "--backend NAME\t\thash table to use, `chained` (default) or "
+         "`swiss`\n"
+         "--top K\t\t\tprint only the K most common words, the most common "
+         "first\n"
+         "--sort count|key\tsort the words by count (the highest first) or "
+         "by the word itself; with --top, only the K words are sorted\n"
+         "--approx N\t\tcount approximately in a fixed amount of memory, "
+         "tracking only about N of the most common words; prints COUNT WORD "
+         "ERROR, where the word occurred between COUNT - ERROR and COUNT "
+         "times, and every word more common than 1/N of all the words is "
+         "included\n"
+         "--distinct\t\testimate the number of different words in a fixed "
+         "amount of memory (about 1.6 % error)\n"
+         "--save-sketch FILE\twith --distinct, save the estimate to be "
+         "merged later\n"
+         "--merge-sketch FILE\twith --distinct, add the words of a saved "
+         "sketch, can be repeated; standard input isn't read then, only a "
+         "given FILE\n"
+         "--save-table FILE\talso save the counts to FILE, to be used with "
+         "--table\n"
+         "--table FILE\t\tinstead of counting, print the count of every "
+         "word of the input in a table saved by --save-table\n"
+         "--checkpoint FILE\tcontinue counting the FILE where the last run "
+         "with the same checkpoint stopped, and save where this one did; "
+         "for files that are only appended to\n"
+         "--stats\t\t\tprint the statistics of the hash table to standard "
+         "error: list lengths, keys compared per lookup, memory\n"
+         "--lower\t\t\tlowercase the words before counting them (ASCII, "
+         "and Latin, Greek and Cyrillic letters in UTF-8)\n"
+         "--strip CHARS\t\tremove these characters from the start and the "
+         "end of the words, words made only of them aren't counted\n"
+         "--strip-punct\t\tthe same as --strip with all ASCII punctuation");
 }
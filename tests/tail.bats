@@ -7,7 +7,7 @@ RESULT=$BATS_TMPDIR"/result.txt"
 TEST_FILES=$BATS_TEST_DIRNAME"/files"
 MAIN_FILE=$TEST_FILES"/tail_1to15.txt"
 
-# can be found in tail.c, but in this case we don't include \n and \0
+# lines used to be limited to this length (without \n and \0)
 MAX_LINE_LENGTH=1024
 
 
@@ -27,10 +27,16 @@ MAX_LINE_LENGTH=1024
     [[ "$output" =~ "Invalid parameter" ]]
 }
 
-@test "invalid params - two files specified" {
-    run $CMD -6 $MAIN_FILE $MAIN_FILE
+@test "invalid params - -c without a number" {
+    run $CMD $MAIN_FILE -c
     [ $status -eq 1 ]
-    [[ "$output" =~ "The FILE can be set only once" ]]
+    [[ "$output" =~ "Missing number of bytes" ]]
+}
+
+@test "invalid params - lines and bytes" {
+    run $CMD -6 -c 5 $MAIN_FILE
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Too many parameters" ]]
 }
 
 @test "invalid params - two limits" {
@@ -51,6 +57,45 @@ MAX_LINE_LENGTH=1024
     diff $EXPECTED $RESULT
 }
 
+@test "more files" {
+    OTHER=$TEST_FILES"/tail_1to8.txt"
+    $CMD -6 $MAIN_FILE $OTHER $MAIN_FILE > $RESULT
+    tail -n 6 $MAIN_FILE $OTHER $MAIN_FILE > $EXPECTED
+    diff $EXPECTED $RESULT
+}
+
+@test "more files, one of them missing" {
+    OTHER=$TEST_FILES"/tail_1to8.txt"
+    run $CMD -2 $MAIN_FILE file_that_doesnt_exist.txt $OTHER
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Can't open file 'file_that_doesnt_exist.txt'" ]]
+    $CMD -2 $MAIN_FILE file_that_doesnt_exist.txt $OTHER > $RESULT || true
+    tail -n 2 $MAIN_FILE $OTHER > $EXPECTED
+    diff $EXPECTED $RESULT
+}
+
+@test "last bytes" {
+    FILE=$TEST_FILES"/book.txt"
+    for n in 0 1 100 65536 100000 10000000; do
+        $CMD -c $n $FILE > $RESULT
+        tail -c $n $FILE > $EXPECTED
+        diff $EXPECTED $RESULT
+        cat $FILE | $CMD -c$n > $RESULT
+        diff $EXPECTED $RESULT
+    done
+}
+
+@test "bytes starting from a byte" {
+    FILE=$TEST_FILES"/book.txt"
+    for n in 0 1 2 100 65537 10000000; do
+        $CMD -c +$n $FILE > $RESULT
+        tail -c +$n $FILE > $EXPECTED
+        diff $EXPECTED $RESULT
+        cat $FILE | $CMD -c +$n > $RESULT
+        diff $EXPECTED $RESULT
+    done
+}
+
 @test "everything starting from second line" {
     $CMD +2 $MAIN_FILE > $RESULT
     tail -n +2 $MAIN_FILE > $EXPECTED
@@ -63,6 +108,24 @@ MAX_LINE_LENGTH=1024
     diff $EXPECTED $RESULT
 }
 
+@test "everything from a line, through pipes" {
+    FILE=$TEST_FILES"/book.txt"
+    for n in 1 2 1000 10000; do
+        cat $FILE | $CMD +$n | cat > $RESULT
+        tail -n +$n $FILE > $EXPECTED
+        diff $EXPECTED $RESULT
+    done
+}
+
+@test "everything from a line, appended to a file" {
+    FILE=$TEST_FILES"/book.txt"
+    echo first > $RESULT
+    $CMD +100 $FILE >> $RESULT
+    echo first > $EXPECTED
+    tail -n +100 $FILE >> $EXPECTED
+    diff $EXPECTED $RESULT
+}
+
 @test "all lines" {
     $CMD +0 $MAIN_FILE > $RESULT
     tail -n +0 $MAIN_FILE > $EXPECTED
@@ -75,6 +138,15 @@ MAX_LINE_LENGTH=1024
     diff $EXPECTED $RESULT
 }
 
+@test "no lines of more files" {
+    $CMD -0 $MAIN_FILE $MAIN_FILE > $RESULT
+    tail -n -0 $MAIN_FILE $MAIN_FILE > $EXPECTED
+    diff $EXPECTED $RESULT
+    [ ! -s $RESULT ]
+    $CMD -c 0 $MAIN_FILE $MAIN_FILE > $RESULT
+    [ ! -s $RESULT ]
+}
+
 @test "without parameters" {
     $CMD $MAIN_FILE > $RESULT
     tail $MAIN_FILE > $EXPECTED
@@ -88,6 +160,131 @@ MAX_LINE_LENGTH=1024
     diff $EXPECTED $RESULT
 }
 
+@test "last lines of a regular file given as standard input" {
+    FILE=$TEST_FILES"/book.txt"
+    $CMD -25 < $FILE > $RESULT
+    tail -25 $FILE > $EXPECTED
+    diff $EXPECTED $RESULT
+}
+
+@test "last lines from a pipe" {
+    FILE=$TEST_FILES"/book.txt"
+    cat $FILE | $CMD -25 > $RESULT
+    tail -25 $FILE > $EXPECTED
+    diff $EXPECTED $RESULT
+}
+
+@test "file without a newline at the end" {
+    FILE=$BATS_TMPDIR"/no_newline.txt"
+    printf 'first\nsecond\n\nlast' > $FILE
+    for n in 1 2 3 4 5; do
+        $CMD -$n $FILE > $RESULT
+        tail -$n $FILE > $EXPECTED
+        diff $EXPECTED $RESULT
+    done
+}
+
+@test "more lines than fit into one block" {
+    FILE=$BATS_TMPDIR"/numbers.txt"
+    seq 1 100000 > $FILE
+    $CMD -30000 $FILE > $RESULT
+    tail -30000 $FILE > $EXPECTED
+    diff $EXPECTED $RESULT
+}
+
+# wait until file $1 has at least $2 lines, for at most 5 seconds
+function wait_for_lines {
+    for i in $(seq 1 500); do
+        [ -f $1 ] && [ $(wc -l < $1) -ge $2 ] && return 0
+        sleep 0.01
+    done
+    return 1
+}
+
+@test "follow needs a file" {
+    run $CMD -f
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Following needs a FILE" ]]
+}
+
+@test "follow appended lines" {
+    FILE=$BATS_TMPDIR"/follow.txt"
+    seq 1 15 > $FILE
+    $CMD -2 -f $FILE > $RESULT &
+    TAIL_PID=$!
+    wait_for_lines $RESULT 2
+    echo 16 >> $FILE
+    printf '17\n18\n' >> $FILE
+    wait_for_lines $RESULT 5
+    kill $TAIL_PID
+    tail -5 $FILE > $EXPECTED
+    diff $EXPECTED $RESULT
+}
+
+@test "follow a truncated file" {
+    FILE=$BATS_TMPDIR"/follow.txt"
+    seq 1 15 > $FILE
+    $CMD -1 -f $FILE > $RESULT 2> /dev/null &
+    TAIL_PID=$!
+    wait_for_lines $RESULT 1
+    echo first > $FILE
+    wait_for_lines $RESULT 2
+    kill $TAIL_PID
+    printf '15\nfirst\n' > $EXPECTED
+    diff $EXPECTED $RESULT
+}
+
+@test "follow a rotated file by name" {
+    FILE=$BATS_TMPDIR"/follow.txt"
+    rm -f $FILE $FILE.1
+    seq 1 3 > $FILE
+    $CMD -F $FILE > $RESULT 2> /dev/null &
+    TAIL_PID=$!
+    wait_for_lines $RESULT 3
+    mv $FILE $FILE.1
+    echo old >> $FILE.1
+    wait_for_lines $RESULT 4
+    echo new > $FILE
+    wait_for_lines $RESULT 5
+    kill $TAIL_PID
+    printf '1\n2\n3\nold\nnew\n' > $EXPECTED
+    diff $EXPECTED $RESULT
+}
+
+@test "follow a file that doesn't exist yet until the output fails" {
+    FILE=$BATS_TMPDIR"/follow_new.txt"
+    rm -f $FILE
+    timeout 10 $CMD -F $FILE > /dev/full 2> $RESULT &
+    TAIL_PID=$!
+    sleep 0.2
+    echo line > $FILE
+    STATUS=0
+    wait $TAIL_PID || STATUS=$?
+    [ $STATUS -eq 1 ]
+    grep -q "Can't write the output" $RESULT
+}
+
+@test "follow latency" {
+    FILE=$BATS_TMPDIR"/follow.txt"
+    : > $FILE
+    # every line that comes out of tail gets the time when it was received
+    $CMD -f $FILE | while read sent; do
+        echo "$sent $(date +%s%N)"
+    done > $RESULT &
+    sleep 0.2
+    # the writer appends the time when the line was written
+    (for i in $(seq 1 20); do date +%s%N >> $FILE; sleep 0.05; done) &
+    wait $!
+    wait_for_lines $RESULT 20
+    kill $(jobs -p) 2> /dev/null || true
+    # latency in microseconds: average and maximum
+    awk '{ l = ($2 - $1) / 1000; sum += l; if(l > max) max = l }
+         END { printf "lines=%d avg_us=%d max_us=%d\n", NR, sum / NR, max }' \
+        $RESULT
+    [ $(awk '{ if($2 - $1 > max) max = $2 - $1 } END { print max }' \
+        $RESULT) -lt 250000000 ]
+}
+
 @test "valgrind check" {
     run valgrind $CMD -2 $MAIN_FILE
     [ $status -eq 0 ]
@@ -112,8 +309,27 @@ MAX_LINE_LENGTH=1024
 @test "line with $MAX_LINE_LENGTH + 1 characters" {
     FILE=$TEST_FILES"/tail_1025chars.txt"
     run valgrind $CMD $FILE
-    [ $status -eq 1 ]
-    [[ "$output" =~ "Line too long" ]]
+    [ $status -eq 0 ]
     [[ "$output" =~ "no leaks are possible" ]]
     [[ "$output" =~ " 0 errors from 0 contexts" ]]
+    $CMD $FILE > $RESULT
+    tail $FILE > $EXPECTED
+    diff $EXPECTED $RESULT
+}
+
+@test "long lines from a pipe" {
+    FILE=$BATS_TMPDIR"/long_lines.txt"
+    for i in 1 2 3 4 5; do
+        head -c $((i * 100000)) /dev/zero | tr '\0' 'x'
+        echo
+        echo short
+    done > $FILE
+    for n in 1 2 3 4 7 20; do
+        cat $FILE | $CMD -$n > $RESULT
+        tail -$n $FILE > $EXPECTED
+        diff $EXPECTED $RESULT
+        $CMD +$n $FILE > $RESULT
+        tail -n +$n $FILE > $EXPECTED
+        diff $EXPECTED $RESULT
+    done
 }
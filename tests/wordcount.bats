@@ -4,8 +4,7 @@ EXPECTED=$BATS_TMPDIR"/expected.txt"
 RESULT=$BATS_TMPDIR"/result.txt"
 TEST_FILES=$BATS_TEST_DIRNAME"/files"
 
-# constant that can be found in `wordcount.c` (lowered by 1, since it usually
-# counts the ending '\0' character too
+# words used to be shortened to this length
 MAX_WORD_LENGTH=100
 
 # use standard UNIX tools to get a similar result as the `wordcount` program
@@ -68,13 +67,499 @@ function wordcount_unix_tools {
     diff $EXPECTED $RESULT
 }
 
-@test "words longer than $MAX_WORD_LENGTH characters" {
+@test "words longer than $MAX_WORD_LENGTH characters are not shortened" {
     FILE=$TEST_FILES"/wordcount_long_words.txt"
-    EXPECTED=$TEST_FILES"/wordcount_long_words_result.txt"
+    wordcount_unix_tools $FILE
     run bash -c "cat $FILE | valgrind ./wordcount | sort -n > $RESULT"
     diff $EXPECTED $RESULT
     [ $status -eq 0 ]
-    [[ "$output" =~ "Warning: Some words may be shortened" ]]
+    [[ ! "$output" =~ "Warning" ]]
     [[ "$output" =~ "no leaks are possible" ]]
     [[ "$output" =~ " 0 errors from 0 contexts" ]]
 }
+
+@test "very long word from a pipe" {
+    # longer than the blocks in which the tokenizer reads pipes
+    head -c 200000 /dev/zero | tr '\0' 'x' > $BATS_TMPDIR/long_word.txt
+    echo " short x" >> $BATS_TMPDIR/long_word.txt
+    wordcount_unix_tools $BATS_TMPDIR/long_word.txt
+    cat $BATS_TMPDIR/long_word.txt | ./wordcount | sort -n > $RESULT
+    diff $EXPECTED $RESULT
+}
+
+@test "pipe gives the same counts as a file with words of any length" {
+    # words are looked up in batches, those of a pipe are copied into a
+    # buffer of 4 KB first
+    awk 'BEGIN { for(i = 0; i < 3000; i++) {
+            len = (i * 7919) % 5000 + 1
+            w = sprintf("%0" len "d", i % 50)
+            print w, i % 13 }
+    }' > $BATS_TMPDIR/lengths.txt
+    for BACKEND in chained swiss; do
+        ./wordcount --backend $BACKEND --sort key $BATS_TMPDIR/lengths.txt \
+            > $EXPECTED
+        cat $BATS_TMPDIR/lengths.txt |
+            ./wordcount --backend $BACKEND --sort key > $RESULT
+        diff $EXPECTED $RESULT
+    done
+    [ $(wc -l < $EXPECTED) -gt 3000 ]
+}
+
+@test "write errors are reported" {
+    FILE=$TEST_FILES"/book.txt"
+    for OPTIONS in "" "--sort key" "--approx 100"; do
+        run bash -c "./wordcount $OPTIONS $FILE > /dev/full"
+        [ $status -eq 1 ]
+        [[ "$output" =~ "Can't write the output" ]]
+    done
+}
+
+@test "swiss table backend" {
+    FILE=$TEST_FILES"/book.txt"
+    wordcount_unix_tools $FILE
+    cat $FILE | ./wordcount --backend swiss | sort -n > $RESULT
+    diff $EXPECTED $RESULT
+}
+
+@test "words are printed in the order of their first appearance" {
+    FILE=$TEST_FILES"/book.txt"
+    LC_ALL=C tr ' \t\r\v\f' '\n' < $FILE |
+        LC_ALL=C awk '$0 != "" && !seen[$0]++' > $EXPECTED
+    for BACKEND in chained swiss; do
+        ./wordcount --backend $BACKEND $FILE | cut -d' ' -f2 > $RESULT
+        diff $EXPECTED $RESULT
+    done
+}
+
+@test "unknown backend" {
+    run ./wordcount --backend foo
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Invalid backend" ]]
+}
+
+@test "file given as a parameter" {
+    FILE=$TEST_FILES"/book.txt"
+    wordcount_unix_tools $FILE
+    ./wordcount $FILE | sort -n > $RESULT
+    diff $EXPECTED $RESULT
+}
+
+@test "multiple threads give exactly the same output as one" {
+    FILE=$TEST_FILES"/book.txt"
+    ./wordcount $FILE > $EXPECTED
+    for jobs in 2 3 8; do
+        ./wordcount -j $jobs $FILE > $RESULT
+        diff $EXPECTED $RESULT
+    done
+}
+
+@test "multiple threads stop at a word starting with NUL like one" {
+    FILE=$BATS_TMPDIR/nul_word.txt
+    for PREFIX in "" "$(seq 50000)"; do
+        { echo "$PREFIX"; printf 'x \0d a b\n'; seq 100000; } > $FILE
+        ./wordcount $FILE > $EXPECTED
+        cat $FILE | ./wordcount | cmp - $EXPECTED
+        for jobs in 2 4 7; do
+            ./wordcount -j $jobs $FILE > $RESULT
+            cmp $EXPECTED $RESULT
+        done
+    done
+}
+
+@test "multiple threads on a pipe" {
+    seq 1000 > $EXPECTED
+    seq 1000 | ./wordcount -j 2 /dev/stdin | cut -d' ' -f2 > $RESULT
+    diff $EXPECTED $RESULT
+    ./wordcount -j 3 <(seq 1000) | cut -d' ' -f2 > $RESULT
+    diff $EXPECTED $RESULT
+}
+
+@test "multiple threads on a small file" {
+    FILE=$TEST_FILES"/wordcount_simple2.txt"
+    wordcount_unix_tools $FILE
+    ./wordcount -j 32 $FILE | sort -n > $RESULT
+    diff $EXPECTED $RESULT
+}
+
+@test "multiple threads on an empty file" {
+    run ./wordcount -j 4 $TEST_FILES"/empty_file.txt"
+    [ $status -eq 0 ]
+    [ "$output" = "" ]
+}
+
+@test "multiple threads without a file" {
+    run ./wordcount -j 4
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Parameter -j needs a FILE" ]]
+}
+
+@test "sorted by count" {
+    FILE=$TEST_FILES"/book.txt"
+    ./wordcount $FILE | LC_ALL=C sort -k1,1nr -k2,2 > $EXPECTED
+    ./wordcount --sort count $FILE > $RESULT
+    diff $EXPECTED $RESULT
+}
+
+@test "sorted by key" {
+    FILE=$TEST_FILES"/book.txt"
+    ./wordcount $FILE | LC_ALL=C sort -k2,2 > $EXPECTED
+    cat $FILE | ./wordcount --sort key > $RESULT
+    diff $EXPECTED $RESULT
+}
+
+@test "sorted keys with NUL bytes" {
+    # more keys than are sorted with qsort() alone
+    { seq 3000; seq 1000; } | sed 's/^/k\x00/; 0~3s/$/\x00/' > $BATS_TMPDIR/nul.txt
+    ./wordcount $BATS_TMPDIR/nul.txt | LC_ALL=C sort -k2,2 > $EXPECTED
+    ./wordcount --sort key $BATS_TMPDIR/nul.txt > $RESULT
+    cmp $EXPECTED $RESULT
+    ./wordcount $BATS_TMPDIR/nul.txt | LC_ALL=C sort -k1,1nr -k2,2 > $EXPECTED
+    ./wordcount --sort count $BATS_TMPDIR/nul.txt > $RESULT
+    cmp $EXPECTED $RESULT
+    ./wordcount --top 10 $BATS_TMPDIR/nul.txt | head -10 > $RESULT
+    head -10 $EXPECTED | cmp - $RESULT
+}
+
+@test "top words" {
+    FILE=$TEST_FILES"/book.txt"
+    for k in 1 10 1000 1000000; do
+        ./wordcount $FILE | LC_ALL=C sort -k1,1nr -k2,2 | head -$k > $EXPECTED
+        ./wordcount --top $k $FILE > $RESULT
+        diff $EXPECTED $RESULT
+        ./wordcount -j 3 --top $k --backend swiss $FILE > $RESULT
+        diff $EXPECTED $RESULT
+    done
+}
+
+@test "top words sorted by key" {
+    FILE=$TEST_FILES"/book.txt"
+    ./wordcount $FILE | LC_ALL=C sort -k1,1nr -k2,2 | head -100 |
+        LC_ALL=C sort -k2,2 > $EXPECTED
+    ./wordcount --top 100 --sort key $FILE > $RESULT
+    diff $EXPECTED $RESULT
+}
+
+@test "top words of empty input" {
+    run ./wordcount --top 5 $TEST_FILES"/empty_file.txt"
+    [ $status -eq 0 ]
+    [ "$output" = "" ]
+}
+
+@test "invalid top and sort values" {
+    run ./wordcount --top 0
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Invalid number of words" ]]
+    run ./wordcount --top -5
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Invalid number of words" ]]
+    run ./wordcount --sort foo
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Invalid sort order" ]]
+}
+
+# prints the recall of the approximate top words: the part of the exact top
+# $1 words that are also in the approximate top $1, tracking $2 words
+function approx_recall {
+    FILE=$TEST_FILES"/book.txt"
+    ./wordcount --top $1 $FILE | cut -d' ' -f2 | sort > $EXPECTED
+    ./wordcount --approx $2 --top $1 $FILE | cut -d' ' -f2 | sort > $RESULT
+    echo $(( $(comm -12 $EXPECTED $RESULT | wc -l) * 100 / $1 ))
+}
+
+@test "approximate top words have a high recall" {
+    # the book has about 18000 different words
+    [ $(approx_recall 10 500) -eq 100 ]
+    [ $(approx_recall 100 2000) -ge 95 ]
+    [ $(approx_recall 1000 5000) -ge 90 ]
+}
+
+@test "approximate counts are within their error bounds" {
+    FILE=$TEST_FILES"/book.txt"
+    ./wordcount $FILE | awk '{ print $2, $1 }' | LC_ALL=C sort > $EXPECTED
+    ./wordcount --approx 500 $FILE | awk '{ print $2, $1, $3 }' |
+        LC_ALL=C sort > $RESULT
+    # word, exact count, approximate count, error
+    LC_ALL=C join $EXPECTED $RESULT > $BATS_TMPDIR/joined.txt
+    [ $(wc -l < $BATS_TMPDIR/joined.txt) -eq 500 ]
+    awk '$2 > $3 || $2 < $3 - $4 { bad++ } END { exit bad > 0 }' \
+        $BATS_TMPDIR/joined.txt
+}
+
+@test "approximate counting keeps every frequent word" {
+    FILE=$TEST_FILES"/book.txt"
+    TOTAL=$(wc -w < $FILE)
+    # every word that occurs more than TOTAL / 50 times
+    ./wordcount $FILE | awk -v limit=$((TOTAL / 50)) '$1 > limit { print $2 }' |
+        sort > $EXPECTED
+    cat $FILE | ./wordcount --approx 50 | cut -d' ' -f2 | sort > $RESULT
+    [ -s $EXPECTED ]
+    [ -z "$(comm -23 $EXPECTED $RESULT)" ]
+}
+
+@test "approximate counts of keys with NUL bytes" {
+    printf 'ab\0cd ab\0xx ab\0xx ab ab\0cd\0 ab\0cd\n' > $BATS_TMPDIR/nul.txt
+    printf '2 ab\0cd 0\n2 ab\0xx 0\n1 ab 0\n1 ab\0cd\0 0\n' > $EXPECTED
+    ./wordcount --approx 10 $BATS_TMPDIR/nul.txt > $RESULT
+    cmp $EXPECTED $RESULT
+}
+
+@test "approximate counting and valgrind" {
+    FILE=$TEST_FILES"/book.txt"
+    run bash -c "valgrind ./wordcount --approx 100 $FILE > $RESULT"
+    [ $status -eq 0 ]
+    [[ "$output" =~ "no leaks are possible" ]]
+    [[ "$output" =~ " 0 errors from 0 contexts" ]]
+}
+
+@test "invalid approximate counting parameters" {
+    run ./wordcount --approx 0
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Invalid number of words" ]]
+    run ./wordcount --approx 10 -j 2 $TEST_FILES"/book.txt"
+    [ $status -eq 1 ]
+    [[ "$output" =~ "can't be used with -j" ]]
+    run ./wordcount --approx 10 --sort key
+    [ $status -eq 1 ]
+    [[ "$output" =~ "can only sort by count" ]]
+}
+
+@test "distinct words are estimated within a few percent" {
+    FILE=$TEST_FILES"/book.txt"
+    EXACT=$(./wordcount $FILE | wc -l)
+    ESTIMATE=$(cat $FILE | ./wordcount --distinct)
+    [ $(( (ESTIMATE - EXACT) * 100 / EXACT )) -le 3 ]
+    [ $(( (EXACT - ESTIMATE) * 100 / EXACT )) -le 3 ]
+    [ "$(echo "" | ./wordcount --distinct)" = "0" ]
+}
+
+@test "merged sketches give the same estimate as the whole input" {
+    FILE=$TEST_FILES"/book.txt"
+    head -n 5000 $FILE > $BATS_TMPDIR/first.txt
+    tail -n +5001 $FILE > $BATS_TMPDIR/second.txt
+    ./wordcount --distinct --save-sketch $BATS_TMPDIR/first.hll \
+        $BATS_TMPDIR/first.txt
+    ./wordcount --distinct --save-sketch $BATS_TMPDIR/second.hll \
+        $BATS_TMPDIR/second.txt
+    ./wordcount --distinct $FILE > $EXPECTED
+    ./wordcount --distinct --merge-sketch $BATS_TMPDIR/first.hll \
+        --merge-sketch $BATS_TMPDIR/second.hll > $RESULT
+    diff $EXPECTED $RESULT
+    ./wordcount --distinct --merge-sketch $BATS_TMPDIR/first.hll \
+        $BATS_TMPDIR/second.txt > $RESULT
+    diff $EXPECTED $RESULT
+    # a few KB
+    [ $(wc -c < $BATS_TMPDIR/first.hll) -le 8192 ]
+}
+
+@test "distinct words and valgrind" {
+    FILE=$TEST_FILES"/book.txt"
+    ./wordcount --distinct --save-sketch $BATS_TMPDIR/book.hll $FILE
+    run bash -c "valgrind ./wordcount --distinct \
+        --merge-sketch $BATS_TMPDIR/book.hll $FILE > $RESULT"
+    [ $status -eq 0 ]
+    [[ "$output" =~ "no leaks are possible" ]]
+    [[ "$output" =~ " 0 errors from 0 contexts" ]]
+}
+
+@test "invalid distinct parameters and sketches" {
+    run ./wordcount --distinct --merge-sketch $TEST_FILES"/book.txt"
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Can't load sketch" ]]
+    run ./wordcount --distinct --merge-sketch $BATS_TMPDIR/missing.hll
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Can't open sketch" ]]
+    run ./wordcount --save-sketch $BATS_TMPDIR/book.hll
+    [ $status -eq 1 ]
+    [[ "$output" =~ "only be used with --distinct" ]]
+    run ./wordcount --distinct --top 10
+    [ $status -eq 1 ]
+    [[ "$output" =~ "can't be used with" ]]
+}
+
+@test "saved table gives the same counts" {
+    FILE=$TEST_FILES"/book.txt"
+    for BACKEND in chained swiss; do
+        ./wordcount --backend $BACKEND --save-table $BATS_TMPDIR/book.tab \
+            $FILE | sort > $EXPECTED
+        cat $FILE | ./wordcount --table $BATS_TMPDIR/book.tab | sort -u \
+            > $RESULT
+        diff $EXPECTED $RESULT
+    done
+    run bash -c "echo 'the notaword' | ./wordcount --table $BATS_TMPDIR/book.tab"
+    [ "$output" = "$(printf '7906 the\n0 notaword')" ]
+}
+
+@test "saved table and valgrind" {
+    FILE=$TEST_FILES"/book.txt"
+    run bash -c "valgrind ./wordcount --save-table $BATS_TMPDIR/book.tab \
+        $FILE > $RESULT"
+    [ $status -eq 0 ]
+    [[ "$output" =~ "no leaks are possible" ]]
+    [[ "$output" =~ " 0 errors from 0 contexts" ]]
+    run bash -c "valgrind ./wordcount --table $BATS_TMPDIR/book.tab \
+        $FILE > $RESULT"
+    [ $status -eq 0 ]
+    [[ "$output" =~ "no leaks are possible" ]]
+    [[ "$output" =~ " 0 errors from 0 contexts" ]]
+}
+
+@test "invalid saved tables" {
+    FILE=$TEST_FILES"/book.txt"
+    run bash -c "echo the | ./wordcount --table $FILE"
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Can't open table" ]]
+    ./wordcount --save-table $BATS_TMPDIR/book.tab $FILE > /dev/null
+    head -c 1000 $BATS_TMPDIR/book.tab > $BATS_TMPDIR/short.tab
+    run bash -c "echo the | ./wordcount --table $BATS_TMPDIR/short.tab"
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Can't open table" ]]
+    run ./wordcount --table $BATS_TMPDIR/book.tab --top 5
+    [ $status -eq 1 ]
+    [[ "$output" =~ "can't be used with other options" ]]
+}
+
+@test "checkpoint counts only what was appended" {
+    FILE=$TEST_FILES"/book.txt"
+    LOG=$BATS_TMPDIR/log.txt
+    CHECKPOINT=$BATS_TMPDIR/log.checkpoint
+    rm -f $LOG $CHECKPOINT
+    touch $LOG
+    # some of the parts end in the middle of a word
+    for SIZE in 1000 1003 250017 250018 $(wc -c < $FILE); do
+        head -c $SIZE $FILE | tail -c +$(( $(wc -c < $LOG) + 1 )) >> $LOG
+        ./wordcount $LOG | sort > $EXPECTED
+        ./wordcount --checkpoint $CHECKPOINT $LOG | sort > $RESULT
+        diff $EXPECTED $RESULT
+    done
+    # nothing appended
+    ./wordcount --checkpoint $CHECKPOINT $LOG | sort > $RESULT
+    diff $EXPECTED $RESULT
+}
+
+@test "checkpoint of a replaced file counts it all" {
+    LOG=$BATS_TMPDIR/log.txt
+    CHECKPOINT=$BATS_TMPDIR/log.checkpoint
+    rm -f $LOG $CHECKPOINT
+    echo "one two two" > $LOG
+    ./wordcount --checkpoint $CHECKPOINT $LOG > /dev/null
+    echo "three" > $LOG.new
+    mv $LOG.new $LOG
+    run ./wordcount --checkpoint $CHECKPOINT $LOG
+    [ $status -eq 0 ]
+    [[ "$output" =~ "changed since the checkpoint" ]]
+    [[ "$output" =~ "1 three" ]]
+    [[ ! "$output" =~ "two" ]]
+    # rewritten in place, with more than before
+    echo "four five six seven" > $LOG
+    run ./wordcount --checkpoint $CHECKPOINT $LOG
+    [[ "$output" =~ "changed since the checkpoint" ]]
+    [[ ! "$output" =~ "three" ]]
+}
+
+@test "checkpoint and valgrind" {
+    FILE=$TEST_FILES"/book.txt"
+    CHECKPOINT=$BATS_TMPDIR/book.checkpoint
+    rm -f $CHECKPOINT
+    head -c 100003 $FILE > $BATS_TMPDIR/log.txt
+    ./wordcount --checkpoint $CHECKPOINT $BATS_TMPDIR/log.txt > /dev/null
+    cat $FILE >> $BATS_TMPDIR/log.txt
+    run bash -c "valgrind ./wordcount --checkpoint $CHECKPOINT \
+        $BATS_TMPDIR/log.txt > $RESULT"
+    [ $status -eq 0 ]
+    [[ "$output" =~ "no leaks are possible" ]]
+    [[ "$output" =~ " 0 errors from 0 contexts" ]]
+}
+
+@test "invalid checkpoint parameters" {
+    run bash -c "echo a | ./wordcount --checkpoint $BATS_TMPDIR/x.checkpoint"
+    [ $status -eq 1 ]
+    [[ "$output" =~ "needs a FILE" ]]
+    run ./wordcount --checkpoint $BATS_TMPDIR/x.checkpoint -j 2 \
+        $TEST_FILES"/book.txt"
+    [ $status -eq 1 ]
+    [[ "$output" =~ "can't be used with -j" ]]
+    run ./wordcount --checkpoint $TEST_FILES"/book.txt" \
+        $TEST_FILES"/book.txt"
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Can't open checkpoint" ]]
+}
+
+@test "statistics of the table" {
+    FILE=$TEST_FILES"/book.txt"
+    STATS=$BATS_TMPDIR/stats.txt
+    for BACKEND in chained swiss; do
+        ./wordcount --backend $BACKEND $FILE > $EXPECTED
+        ./wordcount --backend $BACKEND --stats $FILE > $RESULT 2> $STATS
+        # the output doesn't change
+        diff $EXPECTED $RESULT
+        WORDS=$(awk '{ words += $1 } END { print words }' $EXPECTED)
+        grep -q "^keys: $(wc -l < $EXPECTED)$" $STATS
+        grep -q "^lookups: $WORDS$" $STATS
+        grep -q "per lookup: " $STATS
+        grep -q "^memory: " $STATS
+    done
+    # every list is counted once
+    ./wordcount --stats $FILE 2> $STATS > /dev/null
+    LISTS=$(grep "^lists: " $STATS | cut -d' ' -f2)
+    grep "^list lengths: " $STATS | tr ' ' '\n' | grep = | cut -d= -f2 |
+        awk -v lists=$LISTS '{ sum += $1 } END { exit sum != lists }'
+}
+
+@test "words normalized like with tr and sed" {
+    FILE=$TEST_FILES"/book.txt"
+    LC_ALL=C tr ' \t\r\v\f' '\n' < $FILE | LC_ALL=C tr 'A-Z' 'a-z' |
+        LC_ALL=C sed -e 's/^[[:punct:]]*//' -e 's/[[:punct:]]*$//' \
+                     -e '/^$/d' |
+        LC_ALL=C sort | LC_ALL=C uniq -c | sed 's/^ *//' |
+        LC_ALL=C sort > $EXPECTED
+    ./wordcount --lower --strip-punct $FILE | LC_ALL=C sort > $RESULT
+    diff $EXPECTED $RESULT
+    # the same from a pipe, with threads and with the other backend
+    cat $FILE | ./wordcount --lower --strip-punct | LC_ALL=C sort > $RESULT
+    diff $EXPECTED $RESULT
+    ./wordcount -j 4 --lower --strip-punct $FILE | LC_ALL=C sort > $RESULT
+    diff $EXPECTED $RESULT
+    ./wordcount --backend swiss --lower --strip-punct $FILE |
+        LC_ALL=C sort > $RESULT
+    diff $EXPECTED $RESULT
+}
+
+@test "UTF-8 words are lowercased and stripped" {
+    printf '%s\n' "Émile ÉMILE «émile» Ωmega ωMEGA ЖУК жук, Straße" \
+        "„Ÿes“ ÿes DOG dog." > $BATS_TMPDIR/utf8.txt
+    printf '\xc9cole\n' >> $BATS_TMPDIR/utf8.txt
+    ./wordcount --lower --strip ".,«»„“" $BATS_TMPDIR/utf8.txt > $RESULT
+    printf '%s\n' "3 émile" "2 ωmega" "2 жук" "1 straße" "2 ÿes" "2 dog" \
+        > $EXPECTED
+    # a byte that isn't UTF-8 is left as it is
+    printf '1 \xc9cole\n' >> $EXPECTED
+    diff $EXPECTED $RESULT
+}
+
+@test "normalized approximate counts, distinct words and saved tables" {
+    FILE=$TEST_FILES"/book.txt"
+    ./wordcount --lower --strip-punct --top 10 $FILE > $EXPECTED
+    ./wordcount --lower --strip-punct --approx 1000 --top 10 $FILE |
+        cut -d' ' -f1,2 > $RESULT
+    diff $EXPECTED $RESULT
+    # the estimate is within a few percent of the exact count
+    EXACT=$(./wordcount --lower --strip-punct $FILE | wc -l)
+    ESTIMATE=$(./wordcount --distinct --lower --strip-punct $FILE)
+    [ $(( (ESTIMATE - EXACT) * 100 / EXACT )) -le 5 ]
+    [ $(( (EXACT - ESTIMATE) * 100 / EXACT )) -le 5 ]
+    ./wordcount --lower --strip-punct --save-table $BATS_TMPDIR/lower.tab \
+        $FILE > /dev/null
+    echo "The THE the, zebra" |
+        ./wordcount --lower --strip-punct --table $BATS_TMPDIR/lower.tab \
+        > $RESULT
+    THE=$(grep " the$" $EXPECTED | cut -d' ' -f1)
+    printf "$THE the\n$THE the\n$THE the\n0 zebra\n" | diff - $RESULT
+}
+
+@test "invalid characters to strip" {
+    run ./wordcount --strip
+    [ $status -eq 1 ]
+    run ./wordcount --strip $'\xff' $TEST_FILES/book.txt
+    [ $status -eq 1 ]
+    [[ "$output" =~ "Invalid characters to strip" ]]
+}